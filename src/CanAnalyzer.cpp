@@ -27,503 +27,735 @@ void CanAnalyzer::WorkerThread()
     mSampleRateHz = GetSampleRate();
     mCan = GetAnalyzerChannelData( mSettings->mCanChannel );
 
-    InitSampleOffsets();
-    WaitFor7RecessiveBits(); // first of all, let's get at least 7 recessive bits in a row, to make sure we're in-between frames.
+    CanDecoderConfig config;
+    config.mSampleRateHz = mSampleRateHz;
+    config.mBitRate = mSettings->mBitRate;
+    config.mInverted = mSettings->mInverted;
+    config.mGlitchFilterNs = mSettings->mGlitchFilterNs;
+    config.mXlDataBitRate = mSettings->mXlDataBitRate;
+    mDecoder.Init( mCan, config );
+    CAN_STATS( mDecoder.SetStats( &mStats ) );
+
+    InitCommitPolicy();
+    mCache.Reset( mSettings->mCacheFolder );
+    mIsoTp.Reset( mSampleRateHz );
+    mJ1939.Reset( mSampleRateHz );
+    mDbc.Clear();
+    // compiled once per run; decoding never touches the file text again. a file that doesn't load fails the settings, so a false
+    // return here means it went away since; Load leaves the DBC empty and no signals are decoded.
+    if( mSettings->mDbcPath.empty() == false )
+        mDbc.Load( mSettings->mDbcPath );
+#ifdef CAN_DECODER_STATS
+    mStats = CanDecoderStats();
+    {
+        std::lock_guard<std::mutex> lock( mCommittedStatsMutex );
+        mCommittedStats = mStats;
+    }
+#endif
+
+    // bus load windows are aligned to the start of the capture.
+    mBusLoadWindowSamples = U64( mSampleRateHz ) * mSettings->mBusLoadWindowMs / 1000;
+    mBusLoadWindow = BusLoadWindow();
+    mBusLoadWindow.mEndingSample = mBusLoadWindowSamples - 1;
+    mCycleTime.Reset( mSampleRateHz, mSettings->mCycleTimeMultiple );
+    mRemoteRequests.Reset( mSampleRateHz );
+    mGateway.Reset( mSampleRateHz );
+
+    mLiveFeed.Close();
+    if( mSettings->mLiveFeedName.empty() == false )
+        mLiveFeed.Open( mSettings->mLiveFeedName, mSampleRateHz ); // without it, decoding goes on as usual
+
+    // the gateway side is decoded alongside, only as far as the main channel has got.
+    mGatewayCan = NULL;
+    if( mSettings->mGatewayChannel != UNDEFINED_CHANNEL )
+    {
+        mGatewayCan = GetAnalyzerChannelData( mSettings->mGatewayChannel );
+        mGatewayDecoder.Init( mGatewayCan, config );
+    }
+
+    {
+        CAN_STATS( CanStatsTimer sampling_timer( mStats.mSamplingNs ) );
+        // first of all, let's get at least 7 recessive bits in a row, to make sure we're in-between frames.
+        mDecoder.WaitFor7RecessiveBits();
+        if( mGatewayCan != NULL )
+            mGatewayDecoder.WaitFor7RecessiveBits();
+    }
 
     // now let's pull in the frames, one at a time.
     for( ;; )
     {
-        if( mCan->GetBitState() == mSettings->Recessive() )
-            mCan->AdvanceToNextEdge();
+        {
+            CAN_STATS( CanStatsTimer sampling_timer( mStats.mSamplingNs ) );
 
-        // we're at the first DOMINANT edge of the frame
-        GetRawFrame();
-        AnalizeRawFrame();
+            // we're about to wait for the next frame; if the data we have so far is used up, catch the gateway side up and don't
+            // hold back a partial batch.
+            if( mCan->DoMoreTransitionsExistInCurrentData() == false )
+            {
+                if( mGatewayCan != NULL && DrainGatewayFrames() == true )
+                    mFramesSinceCommit++;
+                if( mFramesSinceCommit != 0 )
+                    CommitPendingResults();
+            }
 
-        if( mCanError == true )
-        {
-            FrameV2 frame_v2_error;
-            Frame frame;
-            frame.mStartingSampleInclusive = mErrorStartingSample;
-            frame.mEndingSampleInclusive = mErrorEndingSample;
-            frame.mType = CanError;
-            mResults->AddFrame( frame );
-            mResults->AddFrameV2( frame_v2_error, "can_error", frame.mStartingSampleInclusive, frame.mEndingSampleInclusive );
-            mResults->CancelPacketAndStartNewPacket();
+            mDecoder.AdvanceToStartOfFrame();
+            mDecoder.DecodeFrame();
         }
 
-        U32 count = mCanMarkers.size();
-        for( U32 i = 0; i < count; i++ )
         {
-            if( mCanMarkers[ i ].mType == Standard )
-                mResults->AddMarker( mCanMarkers[ i ].mSample, AnalyzerResults::Dot, mSettings->mCanChannel );
-            else
-                mResults->AddMarker( mCanMarkers[ i ].mSample, AnalyzerResults::ErrorX, mSettings->mCanChannel );
+            CAN_STATS( CanStatsTimer emission_timer( mStats.mEmissionNs ) );
+
+            const std::vector<Frame>& fields = mDecoder.GetFields();
+            U32 num_fields = fields.size();
+            for( U32 i = 0; i < num_fields; i++ )
+                AddField( fields[ i ] );
+
+            // a frame flagged after its ACK slot was still delivered, so its error goes in with the message.
+            if( mDecoder.IsFrameComplete() == true )
+            {
+                if( mDecoder.IsError() == true )
+                    AddDecoderError();
+                CommitPacket( mDecoder.GetStartOfFrame(), mDecoder.GetOccupiedBits() );
+                CAN_STATS( mStats.mFrames++ );
+            }
+            else if( mDecoder.IsError() == true )
+            {
+                AddDecoderError();
+                CancelPacket( mDecoder.GetStartOfFrame(), mDecoder.GetOccupiedBits() );
+                CAN_STATS( mStats.mErrors++ );
+            }
+
+            const std::vector<CanMarker>& markers = mDecoder.GetMarkers();
+            U32 count = markers.size();
+            for( U32 i = 0; i < count; i++ )
+            {
+                if( markers[ i ].mType == Standard )
+                    mResults->AddMarker( markers[ i ].mSample, AnalyzerResults::Dot, mSettings->mCanChannel );
+                else
+                    mResults->AddMarker( markers[ i ].mSample, AnalyzerResults::ErrorX, mSettings->mCanChannel );
+            }
+
+#ifdef CAN_DECODER_STATS
+            if( mStats.mFrames + mStats.mErrors - mStats.mLastReportedFrames >= DECODER_STATS_FRAME_INTERVAL )
+                AddDecoderStatsFrame();
+#endif
+
+            mFramesSinceCommit++;
+            if( ShouldCommitResults() )
+                CommitPendingResults();
         }
 
-        mResults->CommitResults();
-        ReportProgress( mCan->GetSampleNumber() );
         CheckIfThreadShouldExit();
 
-        if( mCanError == true )
+        if( mDecoder.SawErrorFlag() == true )
         {
-            WaitFor7RecessiveBits();
+            CAN_STATS( CanStatsTimer sampling_timer( mStats.mSamplingNs ) );
+            mDecoder.WaitFor7RecessiveBits();
+        }
+
+        if( mCache.IsKeyPending() && mCache.GetNumRecordedPackets() >= RESULTS_CACHE_KEY_PACKETS )
+        {
+            if( mCache.Open( mSettings->GetDecodeSettings().c_str(), mSampleRateHz ) == true )
+                ReplayCache();
         }
     }
 }
 
-void CanAnalyzer::InitSampleOffsets()
+void CanAnalyzer::InitCommitPolicy()
 {
-    mSampleOffsets.resize( 256 );
-
-    double samples_per_bit = double( mSampleRateHz ) / double( mSettings->mBitRate );
-    double samples_behind = 0.0;
-
-    U32 increment = U32( ( samples_per_bit * .5 ) + samples_behind );
-    samples_behind = ( samples_per_bit * .5 ) + samples_behind - double( increment );
-
-    mSampleOffsets[ 0 ] = increment;
-    U32 current_offset = increment;
-
-    for( U32 i = 1; i < 256; i++ )
+    if( mSettings->mCommitPolicy == CommitEveryFrame )
+    {
+        mCommitFrameLimit = 1;
+        mCommitSampleSpan = 0;
+    }
+    else
     {
-        U32 increment = U32( samples_per_bit + samples_behind );
-        samples_behind = samples_per_bit + samples_behind - double( increment );
-        current_offset += increment;
-        mSampleOffsets[ i ] = current_offset;
+        mCommitFrameLimit = COMMIT_BATCH_FRAMES;
+        mCommitSampleSpan = U64( double( mSampleRateHz ) * COMMIT_BATCH_SECONDS );
     }
 
-    mNumSamplesIn7Bits = U32( samples_per_bit * 7.0 );
+    mFramesSinceCommit = 0;
+    mLastCommitSample = mCan->GetSampleNumber();
 }
 
-void CanAnalyzer::WaitFor7RecessiveBits()
+bool CanAnalyzer::ShouldCommitResults()
 {
-    if( mCan->GetBitState() == mSettings->Dominant() )
-        mCan->AdvanceToNextEdge();
-
-    for( ;; )
-    {
-        if( mCan->WouldAdvancingCauseTransition( mNumSamplesIn7Bits ) == false )
-            return;
+    // commit once enough frames have piled up, or once enough capture time has passed that a sparse bus still shows progress.
+    if( mFramesSinceCommit >= mCommitFrameLimit )
+        return true;
 
-        mCan->AdvanceToNextEdge();
-        mCan->AdvanceToNextEdge();
-    }
+    return mCan->GetSampleNumber() - mLastCommitSample >= mCommitSampleSpan;
 }
 
-void CanAnalyzer::GetRawFrame()
+void CanAnalyzer::CommitPendingResults()
 {
-    mCanError = false;
-    mRecessiveCount = 0;
-    mDominantCount = 0;
-    mRawBitResults.clear();
+    FlushBusLoadWindows();
+    mResults->CommitResults();
+#ifdef CAN_DECODER_STATS
+    {
+        std::lock_guard<std::mutex> lock( mCommittedStatsMutex );
+        mCommittedStats = mStats;
+    }
+#endif
+    ReportProgress( mCan->GetSampleNumber() );
 
-    if( mCan->GetBitState() != mSettings->Dominant() )
-        AnalyzerHelpers::Assert( "GetFrameOrError assumes we start DOMINANT" );
+    mFramesSinceCommit = 0;
+    mLastCommitSample = mCan->GetSampleNumber();
+}
 
-    mStartOfFrame = mCan->GetSampleNumber();
+void CanAnalyzer::AddField( const Frame& frame )
+{
+    FrameV2 frame_v2;
+    const char* type = "can_error";
+    bool remote_frame = ( frame.mFlags & REMOTE_FRAME ) != 0;
 
-    U32 i = 0;
-    // what we're going to do now is capture a sequence up until we get 7 recessive bits in a row.
-    for( ;; )
+    switch( frame.mType )
     {
-        if( i > 255 )
+    case IdentifierField:
+    case IdentifierFieldEx:
+        mMessage.mIdentifier = U32( frame.mData1 );
+        mMessage.mExtended = frame.mType == IdentifierFieldEx;
+        mMessage.mRemoteFrame = remote_frame;
+        mMessage.mDlc = 0;
+        mMessage.mNumDataBytes = 0;
+        mMessage.mPayloadHash = CAN_PAYLOAD_HASH_START;
+        mMessage.mStartingSample = frame.mStartingSampleInclusive;
+
+        // deadlines that passed before this frame started are reported ahead of it.
+        if( mSettings->mCycleTimeMultiple > 0.0 )
         {
-            // we are in garbage data most likely, lets get out of here.
-            return;
+            mCycleTimeEvents.clear();
+            mCycleTime.AdvanceTo( mMessage.mStartingSample, mMessage.mIdentifier, mMessage.mExtended, mCycleTimeEvents );
+            AddCycleTimeViolations();
         }
 
-        mCan->AdvanceToAbsPosition( mStartOfFrame + mSampleOffsets[ i ] );
-        i++;
+        if( mGatewayCan != NULL )
+            DecodeGatewayFramesBefore( mMessage.mStartingSample );
+        break;
+    case ControlField:
+        mMessage.mDlc = U32( frame.mData1 );
+        break;
+    case XlControlField:
+        mMessage.mDlc = CAN_XL_DLC( frame.mData1 );
+        break;
+    case DataField:
+        if( mMessage.mNumDataBytes < sizeof( mMessage.mData ) )
+            mMessage.mData[ mMessage.mNumDataBytes++ ] = U8( frame.mData1 );
+        mMessage.mPayloadHash = CAN_PAYLOAD_HASH( mMessage.mPayloadHash, frame.mData1 );
+        break;
+    case AckField:
+        mMessage.mEndingSample = frame.mEndingSampleInclusive;
+        break;
+    }
 
-        if( mCan->GetBitState() == mSettings->Dominant() )
+    switch( frame.mType )
+    {
+    case IdentifierField:
+        type = "identifier_field";
+        if( remote_frame == true )
+            frame_v2.AddBoolean( "remote_frame", true );
+        frame_v2.AddInteger( "identifier", frame.mData1 );
+        if( ( frame.mFlags & XL_FRAME ) != 0 )
+            frame_v2.AddBoolean( "xl", true );
+        break;
+    case IdentifierFieldEx:
+        type = "identifier_field";
+        if( remote_frame == true )
+            frame_v2.AddBoolean( "RemoteFrame", true );
+        frame_v2.AddInteger( "identifier", frame.mData1 );
+        frame_v2.AddBoolean( "extended", true );
+        if( mSettings->mJ1939 == true )
         {
-            // the bit is DOMINANT
-            mDominantCount++;
-            mRecessiveCount = 0;
-            mRawBitResults.push_back( mSettings->Dominant() );
-
-            if( mDominantCount == 6 )
-            {
-                // we have detected an error.
-
-                mCanError = true;
-                mErrorStartingSample = mStartOfFrame + mSampleOffsets[ i - 5 ];
-                mErrorEndingSample = mStartOfFrame + mSampleOffsets[ i ];
-
-                // don't use any of these error bits in analysis.
-                mRawBitResults.pop_back();
-                mRawBitResults.pop_back();
-                mRawBitResults.pop_back();
-                mRawBitResults.pop_back();
-                mRawBitResults.pop_back();
-                mRawBitResults.pop_back();
-
-                mNumRawBits = mRawBitResults.size();
-
-                // the channel is currently high.  addvance it to the next start bit.
-                // no, don't bother, we want to analyze this packet before we advance.
-
-                break;
-            }
+            J1939Identifier id = J1939SplitIdentifier( U32( frame.mData1 ) );
+            frame_v2.AddInteger( "priority", id.mPriority );
+            frame_v2.AddInteger( "pgn", id.mPgn );
+            frame_v2.AddInteger( "source_address", id.mSourceAddress );
+            frame_v2.AddInteger( "destination_address", id.mDestinationAddress );
+
+            const char* name = J1939PgnName( id.mPgn );
+            if( name != NULL )
+                frame_v2.AddString( "pgn_name", name );
         }
-        else
+        break;
+    case ControlField:
+        type = "control_field";
+        frame_v2.AddInteger( "num_data_bytes", frame.mData1 );
+        break;
+    case DataField:
+        type = "data_field";
+        frame_v2.AddByte( "data", U8( frame.mData1 ) );
+        break;
+    case CrcField:
+        type = "crc_field";
+        frame_v2.AddInteger( "crc", frame.mData1 );
+        break;
+    case AckField:
+        type = "ack_field";
+        frame_v2.AddBoolean( "ack", frame.mData1 != 0 );
+        break;
+    case XlControlField:
+        type = "xl_control_field";
+        frame_v2.AddInteger( "sdt", CAN_XL_SDT( frame.mData1 ) );
+        frame_v2.AddBoolean( "sec", CAN_XL_SEC( frame.mData1 ) != 0 );
+        frame_v2.AddInteger( "dlc", CAN_XL_DLC( frame.mData1 ) );
+        frame_v2.AddInteger( "num_data_bytes", CAN_XL_DLC( frame.mData1 ) + 1 );
+        frame_v2.AddInteger( "sbc", CAN_XL_SBC( frame.mData1 ) );
+        break;
+    case XlPcrcField:
+        type = "xl_pcrc_field";
+        frame_v2.AddInteger( "crc", frame.mData1 );
+        break;
+    case XlAddressField:
+        type = "xl_address_field";
+        frame_v2.AddInteger( "vcid", CAN_XL_VCID( frame.mData1 ) );
+        frame_v2.AddInteger( "acceptance_field", CAN_XL_AF( frame.mData1 ) );
+        break;
+    case XlFcrcField:
+        type = "xl_fcrc_field";
+        frame_v2.AddInteger( "crc", frame.mData1 );
+        break;
+    case CanError:
+        frame_v2.AddString( "error_type", CanErrorTypeName( CAN_ERROR_TYPE( frame.mData1 ) ) );
+        frame_v2.AddInteger( "bit_position", CAN_ERROR_BIT( frame.mData1 ) );
+        if( CAN_ERROR_HAS_SUSPECT( frame.mData1 ) )
         {
-            // the bit is RECESSIVE
-            mRecessiveCount++;
-            mDominantCount = 0;
-            mRawBitResults.push_back( mSettings->Recessive() );
-
-            if( mRecessiveCount == 7 )
-            {
-                // we're done.
-                break;
-            }
+            frame_v2.AddInteger( "suspect_bit_position", CAN_ERROR_SUSPECT_BIT( frame.mData1 ) );
+            frame_v2.AddInteger( "suspect_bit_sample", frame.mEndingSampleInclusive - CAN_ERROR_SUSPECT_SAMPLES_BEFORE( frame.mData1 ) );
         }
+        mResults->AddError( CAN_ERROR_TYPE( frame.mData1 ) );
+        break;
     }
 
-    mNumRawBits = mRawBitResults.size();
+    mResults->AddFrame( frame );
+    mResults->AddFrameV2( frame_v2, type, frame.mStartingSampleInclusive, frame.mEndingSampleInclusive );
+    mCache.RecordFrame( frame );
 }
 
+void CanAnalyzer::AddDecoderError()
+{
+    Frame frame;
+    frame.mStartingSampleInclusive = mDecoder.GetErrorStartingSample();
+    frame.mEndingSampleInclusive = mDecoder.GetErrorEndingSample();
+    frame.mType = CanError;
+    frame.mData1 = CAN_ERROR_DATA( mDecoder.GetErrorType(), mDecoder.GetErrorBit() );
+
+    // at very low bit rates, a suspect sampled too far before the end of the error doesn't fit, and is left out.
+    U32 suspect_bit;
+    U64 suspect_sample;
+    if( mDecoder.GetErrorSuspectBit( suspect_bit, suspect_sample ) == true &&
+        frame.mEndingSampleInclusive - suspect_sample <= CAN_ERROR_SUSPECT_MAX_SAMPLES_BEFORE )
+        frame.mData1 |= CAN_ERROR_SUSPECT_DATA( suspect_bit, frame.mEndingSampleInclusive - suspect_sample );
+    AddField( frame );
+}
+
+void CanAnalyzer::CommitPacket( U64 start_of_frame, U32 occupied_bits )
+{
+    U64 packet_id = mResults->CommitPacketAndStartNewPacket();
+    mCache.RecordPacket( true, start_of_frame, occupied_bits, mCan->GetSampleNumber(), mDecoder.SawErrorFlag() );
+    AddBusLoad( start_of_frame, occupied_bits, false );
+    OnMessageComplete( packet_id );
+}
 
-void CanAnalyzer::AnalizeRawFrame()
+void CanAnalyzer::CancelPacket( U64 start_of_frame, U32 occupied_bits )
 {
-    BitState bit;
-    U64 last_sample;
+    mResults->CancelPacketAndStartNewPacket();
+    mCache.RecordPacket( false, start_of_frame, occupied_bits, mCan->GetSampleNumber(), mDecoder.SawErrorFlag() );
+    AddBusLoad( start_of_frame, occupied_bits, true );
+}
 
-    UnstuffRawFrameBit( bit, last_sample, true ); // grab the start bit, and reset everything.
-    mArbitrationField.clear();
-    mControlField.clear();
-    mDataField.clear();
-    mCrcFieldWithoutDelimiter.clear();
-    mAckField.clear();
+void CanAnalyzer::AddBusLoad( U64 start_of_frame, U32 occupied_bits, bool error )
+{
+    if( mBusLoadWindowSamples == 0 )
+        return;
 
-    bool done;
+    // a frame counts entirely towards the window it starts in.
+    while( start_of_frame > mBusLoadWindow.mEndingSample )
+        CloseBusLoadWindow();
 
-    mIdentifier = 0;
-    for( U32 i = 0; i < 11; i++ )
-    {
-        mIdentifier <<= 1;
-        BitState bit;
-        done = UnstuffRawFrameBit( bit, last_sample );
-        if( done == true )
-            return;
-        mArbitrationField.push_back( bit );
-
-        if( bit == mSettings->Recessive() )
-            mIdentifier |= 1;
-    }
+    mBusLoadWindow.mBits += occupied_bits;
+    if( error == true )
+        mBusLoadWindow.mErrors++;
+    else
+        mBusLoadWindow.mFrames++;
+}
 
-    // ok, the next three bits will let us know if this is 11-bit or 29-bit can.  If it's 11-bit, then it'll also tell us if this is a
-    // remote frame request or not.
+void CanAnalyzer::CloseBusLoadWindow()
+{
+    double window_s = double( mBusLoadWindowSamples ) / double( mSampleRateHz );
+    double load = 100.0 * double( mBusLoadWindow.mBits ) / ( window_s * double( mSettings->mBitRate ) );
+
+    FrameV2 frame_v2;
+    frame_v2.AddDouble( "load_percent", load );
+    frame_v2.AddInteger( "bits", mBusLoadWindow.mBits );
+    frame_v2.AddInteger( "frames", mBusLoadWindow.mFrames );
+    frame_v2.AddInteger( "errors", mBusLoadWindow.mErrors );
+    mResults->AddFrameV2( frame_v2, "bus_load", mBusLoadWindow.mStartingSample, mBusLoadWindow.mEndingSample );
+    mResults->AddBusLoadWindow( mBusLoadWindow );
+
+    mBusLoadWindow.mStartingSample += mBusLoadWindowSamples;
+    mBusLoadWindow.mEndingSample += mBusLoadWindowSamples;
+    mBusLoadWindow.mBits = 0;
+    mBusLoadWindow.mFrames = 0;
+    mBusLoadWindow.mErrors = 0;
+}
 
-    BitState bit0;
-    done = UnstuffRawFrameBit( bit0, last_sample );
-    if( done == true )
+void CanAnalyzer::FlushBusLoadWindows()
+{
+    // windows otherwise only close when a later frame starts, so the last one would never show up at the end of a capture.
+    // no frame can start before the sample we've decoded (or replayed) up to, so the windows that end before it are complete,
+    // and the open one is handed to the export as it stands.
+    if( mBusLoadWindowSamples == 0 )
         return;
 
-    BitState bit1;
-    done = UnstuffRawFrameBit( bit1, last_sample );
-    if( done == true )
+    U64 sample = mCan->GetSampleNumber();
+    while( sample > mBusLoadWindow.mEndingSample )
+        CloseBusLoadWindow();
+
+    if( sample < mBusLoadWindow.mStartingSample )
         return;
 
-    // ok, if bit1 is dominant, then this is 11-bit.
+    BusLoadWindow partial_window = mBusLoadWindow;
+    partial_window.mEndingSample = sample;
+    mResults->SetOpenBusLoadWindow( partial_window );
+}
 
-    Frame frame;
-    FrameV2 frame_v2_identifier;
+void CanAnalyzer::OnMessageComplete( U64 packet_id )
+{
+    // mMessage now holds the frame that was just committed, whether it was decoded or replayed from the cache.
+    mLiveFeed.Publish( mMessage );
+
+    if( mSettings->mIsoTp == true )
+        ProcessIsoTp( packet_id );
 
+    if( mSettings->mJ1939 == true )
+        ProcessJ1939();
 
-    if( bit1 == mSettings->Dominant() )
+    if( mDbc.IsLoaded() == true )
+        ProcessDbc();
+
+    if( mSettings->mCycleTimeMultiple > 0.0 && mMessage.mRemoteFrame == false )
     {
-        // 11-bit CAN
+        mCycleTimeEvents.clear();
+        mCycleTime.ProcessMessage( mMessage, mCycleTimeEvents );
+        AddCycleTimeViolations();
+    }
 
-        BitState bit2; // since this is 11-bit CAN, we know that bit2 is the r0 bit, which we are going to throw away.
-        done = UnstuffRawFrameBit( bit2, last_sample );
-        if( done == true )
-            return;
+    if( mSettings->mRemoteLatency == true )
+        ProcessRemoteRequests();
 
-        mStandardCan = true;
+    if( mGatewayCan != NULL )
+        ProcessGatewayMessage( GatewaySideA, mMessage );
+}
 
-        frame.mStartingSampleInclusive = mStartOfFrame + mSampleOffsets[ 1 ];
-        frame.mEndingSampleInclusive = last_sample;
-        frame.mType = IdentifierField;
+void CanAnalyzer::ProcessIsoTp( U64 packet_id )
+{
+    mIsoTpEvents.clear();
+    mIsoTp.ProcessMessage( mMessage, packet_id, mIsoTpEvents );
 
-        if( bit0 == mSettings->Recessive() ) // since this is 11-bit CAN, we know that bit0 is the RTR bit
-        {
-            mRemoteFrame = true;
-            frame.mFlags = REMOTE_FRAME;
-            frame_v2_identifier.AddBoolean( "remote_frame", true );
-        }
-        else
+    U32 count = mIsoTpEvents.size();
+    for( U32 i = 0; i < count; i++ )
+    {
+        const IsoTpEvent& event = mIsoTpEvents[ i ];
+        FrameV2 frame_v2;
+
+        frame_v2.AddInteger( "source_id", event.mSourceId );
+        if( event.mTargetId != ISOTP_UNKNOWN_ID )
+            frame_v2.AddInteger( "target_id", event.mTargetId );
+
+        if( event.mType == IsoTpError )
         {
-            mRemoteFrame = false;
-            frame.mFlags = 0;
+            frame_v2.AddString( "reason", event.mReason );
+            mResults->AddFrameV2( frame_v2, "isotp_error", mMessage.mStartingSample, mMessage.mEndingSample );
+            continue;
         }
 
-        frame.mData1 = mIdentifier;
-        frame_v2_identifier.AddInteger( "identifier", mIdentifier );
-        mResults->AddFrame( frame );
-        mResults->AddFrameV2( frame_v2_identifier, "identifier_field", frame.mStartingSampleInclusive, frame.mEndingSampleInclusive );
-    }
-    else
-    {
-        // 29-bit CAN
+        U64 transaction_id = mResults->AddIsoTpTransaction( event.mSourceId, event.mTargetId, event.mData, event.mLength );
+        U32 num_packets = event.mPacketIds->size();
+        for( U32 j = 0; j < num_packets; j++ )
+            mResults->AddPacketToTransaction( transaction_id, ( *event.mPacketIds )[ j ] );
 
-        mStandardCan = false;
+        frame_v2.AddInteger( "length", event.mLength );
+        frame_v2.AddByteArray( "data", event.mData, event.mLength );
+        frame_v2.AddInteger( "frames", num_packets );
+        mResults->AddFrameV2( frame_v2, "isotp_pdu", mMessage.mStartingSample, mMessage.mEndingSample );
+    }
+}
 
-        // get the next 18 address bits.
-        for( U32 i = 0; i < 18; i++ )
-        {
-            mIdentifier <<= 1;
+void CanAnalyzer::ProcessJ1939()
+{
+    mJ1939Events.clear();
+    mJ1939.ProcessMessage( mMessage, mJ1939Events );
 
-            BitState bit;
-            done = UnstuffRawFrameBit( bit, last_sample );
-            if( done == true )
-                return;
-            mArbitrationField.push_back( bit );
+    U32 count = mJ1939Events.size();
+    for( U32 i = 0; i < count; i++ )
+    {
+        const J1939Event& event = mJ1939Events[ i ];
+        FrameV2 frame_v2;
 
-            if( bit == mSettings->Recessive() )
-                mIdentifier |= 1;
-        }
+        frame_v2.AddInteger( "pgn", event.mPgn );
+        frame_v2.AddInteger( "source_address", event.mSourceAddress );
+        frame_v2.AddInteger( "destination_address", event.mDestinationAddress );
+        frame_v2.AddString( "transport", event.mBroadcast ? "BAM" : "CMDT" );
 
-        // get the RTR bit
-        BitState rtr;
-        done = UnstuffRawFrameBit( rtr, last_sample );
-        if( done == true )
-            return;
-
-        // get the r0 and r1 bits (we won't use them)
-        BitState r0;
-        done = UnstuffRawFrameBit( r0, last_sample );
-        if( done == true )
-            return;
-
-        BitState r1;
-        done = UnstuffRawFrameBit( r1, last_sample );
-        if( done == true )
-            return;
-
-        Frame frame;
-        frame.mStartingSampleInclusive = mStartOfFrame + mSampleOffsets[ 1 ];
-        frame.mEndingSampleInclusive = last_sample;
-        frame.mType = IdentifierFieldEx;
-
-        if( rtr == mSettings->Recessive() )
+        if( event.mType == J1939TransferError )
         {
-            mRemoteFrame = true;
-            frame.mFlags = REMOTE_FRAME;
-            frame_v2_identifier.AddBoolean( "RemoteFrame", true );
-        }
-        else
-        {
-            mRemoteFrame = false;
-            frame.mFlags = 0;
+            frame_v2.AddString( "reason", event.mReason );
+            mResults->AddFrameV2( frame_v2, "j1939_error", mMessage.mStartingSample, mMessage.mEndingSample );
+            continue;
         }
 
-        frame.mData1 = mIdentifier;
-        frame_v2_identifier.AddInteger( "identifier", mIdentifier );
-        frame_v2_identifier.AddBoolean( "extended", true );
-        mResults->AddFrame( frame );
-        mResults->AddFrameV2( frame_v2_identifier, "identifier_field", frame.mStartingSampleInclusive, frame.mEndingSampleInclusive );
+        const char* name = J1939PgnName( event.mPgn );
+        if( name != NULL )
+            frame_v2.AddString( "pgn_name", name );
+        frame_v2.AddInteger( "length", event.mLength );
+        frame_v2.AddByteArray( "data", event.mData, event.mLength );
+        mResults->AddFrameV2( frame_v2, "j1939_transport", mMessage.mStartingSample, mMessage.mEndingSample );
     }
+}
 
+void CanAnalyzer::ProcessDbc()
+{
+    if( mMessage.mRemoteFrame == true )
+        return;
 
-    U32 mask = 0x8;
-    mNumDataBytes = 0;
-    U64 first_sample = 0;
-    for( U32 i = 0; i < 4; i++ )
-    {
-        BitState bit;
-        if( i == 0 )
-            done = UnstuffRawFrameBit( bit, first_sample );
-        else
-            done = UnstuffRawFrameBit( bit, last_sample );
-
-        if( done == true )
-            return;
+    const DbcMessage* dbc_message = mDbc.FindMessage( mMessage.mIdentifier, mMessage.mExtended );
+    if( dbc_message == NULL )
+        return;
 
-        mControlField.push_back( bit );
+    mDbcValues.clear();
+    mDbc.Decode( *dbc_message, mMessage, mDbcValues );
 
-        if( bit == mSettings->Recessive() )
-            mNumDataBytes |= mask;
+    FrameV2 frame_v2;
+    frame_v2.AddString( "message", dbc_message->mName.c_str() );
 
-        mask >>= 1;
-    }
-    FrameV2 frame_v2_control;
+    U32 count = mDbcValues.size();
+    for( U32 i = 0; i < count; i++ )
+        frame_v2.AddDouble( mDbcValues[ i ].mSignal->mName.c_str(), mDbcValues[ i ].mValue );
 
-    frame.mStartingSampleInclusive = first_sample;
-    frame.mEndingSampleInclusive = last_sample;
-    frame.mType = ControlField;
-    frame.mData1 = mNumDataBytes;
-    mResults->AddFrame( frame );
-    frame_v2_control.AddInteger( "num_data_bytes", mNumDataBytes );
-    mResults->AddFrameV2( frame_v2_control, "control_field", frame.mStartingSampleInclusive, frame.mEndingSampleInclusive );
+    mResults->AddFrameV2( frame_v2, "dbc_message", mMessage.mStartingSample, mMessage.mEndingSample );
+}
 
-    U32 num_bytes = mNumDataBytes;
-    if( num_bytes > 8 )
-        num_bytes = 8;
+void CanAnalyzer::AddCycleTimeViolations()
+{
+    U32 count = mCycleTimeEvents.size();
+    for( U32 i = 0; i < count; i++ )
+    {
+        const CycleTimeEvent& event = mCycleTimeEvents[ i ];
+        FrameV2 frame_v2;
+
+        frame_v2.AddInteger( "identifier", event.mIdentifier );
+        if( event.mExtended == true )
+            frame_v2.AddBoolean( "extended", true );
+        frame_v2.AddString( "violation", event.mType == CycleTimeLate ? "late" : "missing" );
+        frame_v2.AddDouble( "period_s", double( event.mPeriodSamples ) / double( mSampleRateHz ) );
+        frame_v2.AddDouble( "interval_s", double( event.mIntervalSamples ) / double( mSampleRateHz ) );
+
+        if( event.mType == CycleTimeLate )
+            mResults->AddFrameV2( frame_v2, "timing_violation", mMessage.mStartingSample, mMessage.mEndingSample );
+        else
+            mResults->AddFrameV2( frame_v2, "timing_violation", event.mSample, event.mSample );
+    }
+}
 
-    if( mRemoteFrame == true )
-        num_bytes = 0; // ignore the num_bytes if this is a remote frame.
+void CanAnalyzer::ProcessRemoteRequests()
+{
+    if( mMessage.mRemoteFrame == true )
+        mResults->AddRemoteRequest( mMessage.mIdentifier, mMessage.mExtended );
 
-    for( U32 i = 0; i < num_bytes; i++ )
-    {
-        U32 data = 0;
-        U32 mask = 0x80;
-        for( U32 j = 0; j < 8; j++ )
-        {
-            BitState bit;
+    U64 latency_samples;
+    if( mRemoteRequests.ProcessMessage( mMessage, latency_samples ) == false )
+        return;
 
-            if( j == 0 )
-                done = UnstuffRawFrameBit( bit, first_sample );
-            else
-                done = UnstuffRawFrameBit( bit, last_sample );
+    double latency_s = double( latency_samples ) / double( mSampleRateHz );
+    mResults->AddRemoteResponse( mMessage.mIdentifier, mMessage.mExtended, latency_s );
 
-            if( done == true )
-                return;
+    FrameV2 frame_v2;
+    frame_v2.AddInteger( "identifier", mMessage.mIdentifier );
+    if( mMessage.mExtended == true )
+        frame_v2.AddBoolean( "extended", true );
+    frame_v2.AddDouble( "latency_s", latency_s );
+    mResults->AddFrameV2( frame_v2, "remote_response", mMessage.mStartingSample, mMessage.mEndingSample );
+}
 
-            if( bit == mSettings->Recessive() )
-                data |= mask;
+void CanAnalyzer::DecodeGatewayFramesBefore( U64 sample )
+{
+    // keeps the two channels' messages in order of their starting samples, as the matching expects.
+    while( mGatewayDecoder.AdvanceToStartOfFrameBefore( sample ) == true )
+    {
+        mGatewayDecoder.DecodeFrame();
 
-            mask >>= 1;
+        if( mGatewayDecoder.GetMessage( mGatewayMessage ) == true )
+            ProcessGatewayMessage( GatewaySideB, mGatewayMessage );
 
-            mDataField.push_back( bit );
-        }
-        FrameV2 frame_v2_data;
-        frame.mStartingSampleInclusive = first_sample;
-        frame.mEndingSampleInclusive = last_sample;
-        frame.mType = DataField;
-        frame.mData1 = data;
-        mResults->AddFrame( frame );
-        frame_v2_data.AddByte( "data", data );
-        mResults->AddFrameV2( frame_v2_data, "data_field", frame.mStartingSampleInclusive, frame.mEndingSampleInclusive );
+        if( mGatewayDecoder.SawErrorFlag() == true )
+            mGatewayDecoder.WaitFor7RecessiveBits();
     }
+}
 
-    mCrcValue = 0;
-    for( U32 i = 0; i < 15; i++ )
+bool CanAnalyzer::DrainGatewayFrames()
+{
+    // the main channel is quiet to the end of the data we have, so its next frame starts after every gateway frame that has
+    // started by now. without this, the gateway side would stop being decoded at the last frame of the main channel.
+    bool decoded = false;
+    while( mGatewayCan->DoMoreTransitionsExistInCurrentData() == true )
     {
-        mCrcValue <<= 1;
-        BitState bit;
+        U64 sample = mGatewayCan->GetSampleNumber();
+        while( mGatewayDecoder.AdvanceToStartOfFrameBefore( mGatewayCan->GetSampleOfNextEdge() + 1 ) == true )
+        {
+            mGatewayDecoder.DecodeFrame();
+            decoded = true;
 
-        if( i == 0 )
-            done = UnstuffRawFrameBit( bit, first_sample );
-        else
-            done = UnstuffRawFrameBit( bit, last_sample );
+            if( mGatewayDecoder.GetMessage( mGatewayMessage ) == true )
+                ProcessGatewayMessage( GatewaySideB, mGatewayMessage );
 
-        if( done == true )
-            return;
+            if( mGatewayDecoder.SawErrorFlag() == true )
+                mGatewayDecoder.WaitFor7RecessiveBits();
 
-        mCrcFieldWithoutDelimiter.push_back( bit );
+            if( mGatewayCan->DoMoreTransitionsExistInCurrentData() == false )
+                break;
+        }
 
-        if( bit == mSettings->Recessive() )
-            mCrcValue |= 1;
+        if( mGatewayCan->GetSampleNumber() == sample )
+            break;
     }
-    FrameV2 frame_v2_crc;
-    frame.mStartingSampleInclusive = first_sample;
-    frame.mEndingSampleInclusive = last_sample;
-    frame.mType = CrcField;
-    frame.mData1 = mCrcValue;
-    mResults->AddFrame( frame );
-    frame_v2_crc.AddInteger( "crc", mCrcValue );
-    mResults->AddFrameV2( frame_v2_crc, "crc_field", frame.mStartingSampleInclusive, frame.mEndingSampleInclusive );
 
-    done = UnstuffRawFrameBit( mCrcDelimiter, first_sample );
+    return decoded;
+}
 
-    if( done == true )
+void CanAnalyzer::ProcessGatewayMessage( GatewaySide side, const CanMessage& message )
+{
+    U64 latency_samples;
+    if( mGateway.ProcessMessage( side, message, latency_samples ) == false )
         return;
 
-    BitState ack;
-    done = GetFixedFormFrameBit( ack, first_sample );
+    // message is the forwarded copy; the original was seen on the other side.
+    const char* direction = side == GatewaySideB ? "A->B" : "B->A";
+    double latency_s = double( latency_samples ) / double( mSampleRateHz );
+    mResults->AddGatewayForward( message.mIdentifier, message.mExtended, side, latency_s );
+
+    FrameV2 frame_v2;
+    frame_v2.AddInteger( "identifier", message.mIdentifier );
+    if( message.mExtended == true )
+        frame_v2.AddBoolean( "extended", true );
+    frame_v2.AddString( "direction", direction );
+    frame_v2.AddDouble( "latency_s", latency_s );
+    mResults->AddFrameV2( frame_v2, "gateway_forward", message.mStartingSample, message.mEndingSample );
+}
 
-    mAckField.push_back( ack );
-    if( ack == mSettings->Dominant() )
-        mAck = true;
-    else
-        mAck = false;
+void CanAnalyzer::ReplayCache()
+{
+    // frames are held back until their packet is complete, so a cache cut short mid-packet never leaves a partial packet.
+    std::vector<Frame> packet;
+    Frame frame;
+    U64 start_of_frame;
+    U32 occupied_bits;
+    U64 resume_sample;
+    bool error_flag;
 
-    done = GetFixedFormFrameBit( ack, last_sample );
+    for( ;; )
+    {
+        CanResultsCache::RecordType record = mCache.ReadRecord( frame, start_of_frame, occupied_bits, resume_sample, error_flag );
 
-    if( done == true )
-        return;
+        if( record == CanResultsCache::EndOfCache )
+            break;
 
-    mAckField.push_back( ack );
+        if( record == CanResultsCache::FrameRecord )
+        {
+            packet.push_back( frame );
+            continue;
+        }
 
-    FrameV2 frame_v2_ack;
-    frame.mStartingSampleInclusive = first_sample;
-    frame.mEndingSampleInclusive = last_sample;
-    frame.mType = AckField;
-    frame.mData1 = mAck;
-    mResults->AddFrame( frame );
-    frame_v2_ack.AddBoolean( "ack", mAck );
-    mResults->AddFrameV2( frame_v2_ack, "ack_field", frame.mStartingSampleInclusive, frame.mEndingSampleInclusive );
-    mResults->CommitPacketAndStartNewPacket();
-}
+        // the key only covers the first packets, so every packet replayed has to start on this capture's channel too.
+        CachedFrameCheck check = FindCachedFrame( start_of_frame );
+        if( check != CachedFrameFound )
+        {
+            // either the capture ends here, and live decoding waits for more of it, or the cache is for another capture.
+            mCache.StopReplay( check == ChannelDataUsedUp );
+            break;
+        }
 
-bool CanAnalyzer::GetFixedFormFrameBit( BitState& result, U64& sample )
-{
-    if( mNumRawBits == mRawFrameIndex )
-        return true;
+        SkipCachedFrame( resume_sample );
 
-    result = mRawBitResults[ mRawFrameIndex ];
-    sample = mStartOfFrame + mSampleOffsets[ mRawFrameIndex ];
-    mCanMarkers.push_back( CanMarker( sample, Standard ) );
-    mRawFrameIndex++;
+        U32 count = packet.size();
+        for( U32 i = 0; i < count; i++ )
+            AddField( packet[ i ] );
+        packet.clear();
 
-    return false;
-}
+        if( record == CanResultsCache::PacketCommitRecord )
+            CommitPacket( start_of_frame, occupied_bits );
+        else
+            CancelPacket( start_of_frame, occupied_bits );
 
-bool CanAnalyzer::UnstuffRawFrameBit( BitState& result, U64& sample, bool reset )
-{
-    if( reset == true )
-    {
-        mRecessiveCount = 0;
-        mDominantCount = 0;
-        mRawFrameIndex = 0;
-        mCanMarkers.clear();
+        mFramesSinceCommit++;
+        if( ShouldCommitResults() )
+            CommitPendingResults();
+        CheckIfThreadShouldExit();
+
+        if( error_flag == true )
+            mDecoder.WaitFor7RecessiveBits();
     }
 
-    if( mRawFrameIndex == mNumRawBits )
-        return true;
+    mCache.FinishReplay();
+    CommitPendingResults();
+}
 
-    if( mRecessiveCount == 5 )
-    {
-        mRecessiveCount = 0;
-        mDominantCount = 1; // this bit is DOMINANT, and counts twards the next bit stuff
-        mCanMarkers.push_back( CanMarker( mStartOfFrame + mSampleOffsets[ mRawFrameIndex ], BitStuff ) );
-        mRawFrameIndex++;
-    }
+CachedFrameCheck CanAnalyzer::FindCachedFrame( U64 start_of_frame )
+{
+    // only the edges captured so far are looked at; waiting for more would hold up the replayed results.
+    if( mCan->DoMoreTransitionsExistInCurrentData() == false )
+        return ChannelDataUsedUp;
 
-    if( mDominantCount == 5 )
-    {
-        mDominantCount = 0;
-        mRecessiveCount = 1; // this bit is RECESSIVE, and counts twards the next bit stuff
-        mCanMarkers.push_back( CanMarker( mStartOfFrame + mSampleOffsets[ mRawFrameIndex ], BitStuff ) );
-        mRawFrameIndex++;
-    }
+    // live decoding would have taken the first dominant edge as the start of frame, so it has to be this one.
+    if( mCan->GetBitState() == mSettings->Recessive() && mCan->GetSampleOfNextEdge() > start_of_frame )
+        return CachedFrameMissing;
+    if( mDecoder.AdvanceToStartOfFrameBefore( start_of_frame + 1 ) == false || mCan->GetSampleNumber() != start_of_frame )
+        return CachedFrameMissing;
 
-    if( mRawFrameIndex == mNumRawBits )
-        return true;
+    return CachedFrameFound;
+}
 
-    result = mRawBitResults[ mRawFrameIndex ];
+void CanAnalyzer::SkipCachedFrame( U64 resume_sample )
+{
+    // the channel follows the replay to where live decoding left it, so decoding can pick up after any cached frame. a frame
+    // the capture only has part of so far is waited for, as live decoding would, with the results so far on display.
+    while( mCan->DoMoreTransitionsExistInCurrentData() == true && mCan->GetSampleOfNextEdge() <= resume_sample )
+        mCan->AdvanceToNextEdge();
+    if( mCan->DoMoreTransitionsExistInCurrentData() == false && mFramesSinceCommit != 0 )
+        CommitPendingResults();
 
-    if( result == mSettings->Recessive() )
-    {
-        mRecessiveCount++;
-        mDominantCount = 0;
-    }
-    else
-    {
-        mDominantCount++;
-        mRecessiveCount = 0;
-    }
+    mDecoder.AdvanceToSample( resume_sample );
+}
 
-    sample = mStartOfFrame + mSampleOffsets[ mRawFrameIndex ];
-    mCanMarkers.push_back( CanMarker( sample, Standard ) );
-    mRawFrameIndex++;
+const CanDbc& CanAnalyzer::GetDbc() const
+{
+    return mDbc;
+}
 
-    return false;
+#ifdef CAN_DECODER_STATS
+void CanAnalyzer::AddDecoderStatsFrame()
+{
+    FrameV2 frame_v2_stats;
+    frame_v2_stats.AddInteger( "edges", mStats.mEdgesConsumed );
+    frame_v2_stats.AddInteger( "channel_seeks", mStats.mChannelSeeks );
+    frame_v2_stats.AddInteger( "frames", mStats.mFrames );
+    frame_v2_stats.AddInteger( "stuff_bits", mStats.mStuffBits );
+    frame_v2_stats.AddInteger( "errors", mStats.mErrors );
+    frame_v2_stats.AddInteger( "resyncs", mStats.mResyncs );
+    frame_v2_stats.AddInteger( "glitches", mStats.mGlitches );
+    frame_v2_stats.AddDouble( "sampling_time_s", double( mStats.mSamplingNs ) * 1e-9 );
+    frame_v2_stats.AddDouble( "emission_time_s", double( mStats.mEmissionNs ) * 1e-9 );
+
+    U64 sample = mCan->GetSampleNumber();
+    mResults->AddFrameV2( frame_v2_stats, "decoder_stats", sample, sample );
+
+    mStats.mLastReportedFrames = mStats.mFrames + mStats.mErrors;
 }
 
+CanDecoderStats CanAnalyzer::GetDecoderStats()
+{
+    std::lock_guard<std::mutex> lock( mCommittedStatsMutex );
+    return mCommittedStats;
+}
+#endif
 
 bool CanAnalyzer::NeedsRerun()
 {
@@ -544,6 +776,9 @@ U32 CanAnalyzer::GenerateSimulationData( U64 minimum_sample_index, U32 device_sa
 
 U32 CanAnalyzer::GetMinimumSampleRateHz()
 {
+    // the data phase of CAN XL frames is the fastest part of the bus.
+    if( mSettings->mXlDataBitRate > mSettings->mBitRate )
+        return mSettings->mXlDataBitRate * 8;
     return mSettings->mBitRate * 8;
 }
 
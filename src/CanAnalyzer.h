@@ -4,28 +4,31 @@
 #include <Analyzer.h>
 #include "CanAnalyzerResults.h"
 #include "CanSimulationDataGenerator.h"
-
-enum CanBitType
+#include "CanDecoderStats.h"
+#include "CanResultsCache.h"
+#include "CanMessage.h"
+#include "CanIsoTp.h"
+#include "CanJ1939.h"
+#include "CanDbc.h"
+#include "CanCycleTime.h"
+#include "CanRemoteRequests.h"
+#include "CanFrameDecoder.h"
+#include "CanGateway.h"
+#include "CanLiveFeed.h"
+#include <mutex>
+
+// batched commit policy: hand results to the display after this many frames, or once this much capture time has been decoded.
+#define COMMIT_BATCH_FRAMES 512
+#define COMMIT_BATCH_SECONDS 0.05
+
+// whether a packet replayed from the cache starts on the channel.
+enum CachedFrameCheck
 {
-    Standard,
-    BitStuff
+    CachedFrameFound,
+    CachedFrameMissing,
+    ChannelDataUsedUp // the capture doesn't reach it yet
 };
 
-
-class CanMarker
-{
-  public:
-    CanMarker( U64 sample, enum CanBitType type )
-    {
-        mSample = sample;
-        mType = type;
-    }
-
-    U64 mSample;
-    enum CanBitType mType;
-};
-
-
 class SerialAnalyzerSettings;
 class CanAnalyzer : public Analyzer2
 {
@@ -41,6 +44,11 @@ class CanAnalyzer : public Analyzer2
     virtual const char* GetAnalyzerName() const;
     virtual bool NeedsRerun();
 
+    const CanDbc& GetDbc() const;
+#ifdef CAN_DECODER_STATS
+    CanDecoderStats GetDecoderStats(); // as of the last commit
+#endif
+
 #pragma warning( push )
 #pragma warning(                                                                                                                           \
     disable : 4251 ) // warning C4251: 'SerialAnalyzer::<...>' : class <...> needs to have dll-interface to be used by clients of class
@@ -56,46 +64,74 @@ class CanAnalyzer : public Analyzer2
 
 
   protected: // analysis functions
-    void WaitFor7RecessiveBits();
-    void InitSampleOffsets();
-    void GetRawFrame();
-    void AnalizeRawFrame();
-    bool UnstuffRawFrameBit( BitState& result, U64& sample, bool reset = false );
-    bool GetFixedFormFrameBit( BitState& result, U64& sample );
+    void InitCommitPolicy();
+    bool ShouldCommitResults();
+    void CommitPendingResults();
+
+    void AddField( const Frame& frame );
+    void AddDecoderError(); // the error the decoder ended the frame on
+    void CommitPacket( U64 start_of_frame, U32 occupied_bits );
+    void CancelPacket( U64 start_of_frame, U32 occupied_bits );
+    void ReplayCache();
+    CachedFrameCheck FindCachedFrame( U64 start_of_frame );
+    void SkipCachedFrame( U64 resume_sample );
+    void OnMessageComplete( U64 packet_id );
+    void ProcessIsoTp( U64 packet_id );
+    void ProcessJ1939();
+    void ProcessDbc();
+    void AddBusLoad( U64 start_of_frame, U32 occupied_bits, bool error );
+    void CloseBusLoadWindow();
+    void FlushBusLoadWindows();
+    void AddCycleTimeViolations();
+    void ProcessRemoteRequests();
+    void DecodeGatewayFramesBefore( U64 sample );
+    bool DrainGatewayFrames(); // true if any frame was decoded
+    void ProcessGatewayMessage( GatewaySide side, const CanMessage& message );
+
+#ifdef CAN_DECODER_STATS
+    void AddDecoderStatsFrame();
+#endif
 
   protected: // analysis vars:
     // ChunkedArray<ResultBubble>* mFrameBubbles;
 
-    U32 mNumSamplesIn7Bits;
-    U32 mRecessiveCount;
-    U32 mDominantCount;
-    U32 mRawFrameIndex;
-    U64 mStartOfFrame;
-    U32 mIdentifier;
-    U32 mCrcValue;
-    bool mAck;
-
-    std::vector<U32> mSampleOffsets;
-    std::vector<BitState> mRawBitResults;
-    std::vector<BitState> mBitResults;
-
-    std::vector<CanMarker> mCanMarkers;
-
-    std::vector<BitState> mArbitrationField;
-    bool mStandardCan;
-    bool mRemoteFrame;
-    U32 mNumDataBytes;
-    std::vector<BitState> mControlField;
-    std::vector<BitState> mDataField;
-    std::vector<BitState> mCrcFieldWithoutDelimiter;
-    BitState mCrcDelimiter;
-    std::vector<BitState> mAckField;
-    std::vector<BitState> mEndOfFrame;
-
-    U32 mNumRawBits;
-    bool mCanError;
-    U64 mErrorStartingSample;
-    U64 mErrorEndingSample;
+    CanFrameDecoder mDecoder;
+    CanResultsCache mCache;
+
+    CanMessage mMessage;
+    CanIsoTp mIsoTp;
+    std::vector<IsoTpEvent> mIsoTpEvents;
+    CanJ1939 mJ1939;
+    std::vector<J1939Event> mJ1939Events;
+    CanDbc mDbc;
+    std::vector<DbcValue> mDbcValues;
+
+    U64 mBusLoadWindowSamples; // 0 when bus load is not reported
+    BusLoadWindow mBusLoadWindow;
+
+    CanCycleTime mCycleTime;
+    std::vector<CycleTimeEvent> mCycleTimeEvents;
+
+    CanRemoteRequests mRemoteRequests;
+
+    AnalyzerChannelData* mGatewayCan; // NULL when forwarding latency isn't measured
+    CanFrameDecoder mGatewayDecoder;
+    CanMessage mGatewayMessage;
+    CanGateway mGateway;
+
+    CanLiveFeed mLiveFeed;
+
+    U32 mCommitFrameLimit;
+    U64 mCommitSampleSpan;
+    U32 mFramesSinceCommit;
+    U64 mLastCommitSample;
+
+#ifdef CAN_DECODER_STATS
+    CanDecoderStats mStats; // only touched by the worker thread
+
+    std::mutex mCommittedStatsMutex;
+    CanDecoderStats mCommittedStats; // a copy of mStats for the export thread, taken with each commit
+#endif
 
 #pragma warning( pop )
 };
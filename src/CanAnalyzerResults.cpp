@@ -2,14 +2,20 @@
 #include <AnalyzerHelpers.h>
 #include "CanAnalyzer.h"
 #include "CanAnalyzerSettings.h"
+#include "CanColumnarExport.h"
+#include "CanParallelExport.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 
 #pragma warning( disable : 4800 ) // warning C4800: 'U64' : forcing value to bool 'true' or 'false' (performance warning)
 
 CanAnalyzerResults::CanAnalyzerResults( CanAnalyzer* analyzer, CanAnalyzerSettings* settings )
-    : AnalyzerResults(), mSettings( settings ), mAnalyzer( analyzer )
+    : AnalyzerResults(), mSettings( settings ), mAnalyzer( analyzer ), mHasOpenBusLoad( false )
 {
+    memset( mErrorCounts, 0, sizeof( mErrorCounts ) );
 }
 
 CanAnalyzerResults::~CanAnalyzerResults()
@@ -63,6 +69,12 @@ void CanAnalyzerResults::GenerateBubbleText( U64 frame_index, Channel& /*channel
                 ss << "Extended CAN Identifier: " << number_str << " (RTR)";
         }
 
+        if( frame.HasFlag( XL_FRAME ) )
+            ss << " (XL)";
+
+        if( frame.mType == IdentifierFieldEx && mSettings->mJ1939 == true )
+            ss << " " << J1939Description( frame.mData1, display_base );
+
         AddResultString( ss.str().c_str() );
     }
     break;
@@ -125,160 +137,672 @@ void CanAnalyzerResults::GenerateBubbleText( U64 frame_index, Channel& /*channel
             AddResultString( "NAK" );
     }
     break;
+    case XlControlField:
+    {
+        char number_str[ 128 ];
+        AnalyzerHelpers::GetNumberString( CAN_XL_DLC( frame.mData1 ) + 1, display_base, 12, number_str, 128 );
+
+        std::stringstream ss;
+        AddResultString( "Ctrl" );
+
+        ss << "Ctrl: " << number_str;
+        AddResultString( ss.str().c_str() );
+        ss.str( "" );
+
+        ss << "XL Control Field: " << number_str << " bytes";
+        AddResultString( ss.str().c_str() );
+
+        AnalyzerHelpers::GetNumberString( CAN_XL_SDT( frame.mData1 ), display_base, 8, number_str, 128 );
+        ss << ", SDT " << number_str;
+        if( CAN_XL_SEC( frame.mData1 ) != 0 )
+            ss << ", SEC";
+        AddResultString( ss.str().c_str() );
+    }
+    break;
+    case XlPcrcField:
+    case XlFcrcField:
+    {
+        char number_str[ 128 ];
+        AnalyzerHelpers::GetNumberString( frame.mData1, display_base, frame.mType == XlPcrcField ? 13 : 32, number_str, 128 );
+
+        const char* name = frame.mType == XlPcrcField ? "PCRC" : "FCRC";
+        AddResultString( name );
+
+        std::stringstream ss;
+        ss << name << ": " << number_str;
+        AddResultString( ss.str().c_str() );
+        ss.str( "" );
+
+        ss << ( frame.mType == XlPcrcField ? "Preface CRC value: " : "Frame CRC value: " ) << number_str;
+        AddResultString( ss.str().c_str() );
+    }
+    break;
+    case XlAddressField:
+    {
+        char number_str[ 128 ];
+        AnalyzerHelpers::GetNumberString( CAN_XL_AF( frame.mData1 ), display_base, 32, number_str, 128 );
+
+        AddResultString( "AF" );
+
+        std::stringstream ss;
+        ss << "AF: " << number_str;
+        AddResultString( ss.str().c_str() );
+        ss.str( "" );
+
+        ss << "Acceptance Field: " << number_str;
+        AddResultString( ss.str().c_str() );
+
+        AnalyzerHelpers::GetNumberString( CAN_XL_VCID( frame.mData1 ), display_base, 8, number_str, 128 );
+        ss << ", VCID " << number_str;
+        AddResultString( ss.str().c_str() );
+    }
+    break;
     case CanError:
     {
+        const char* type = CanErrorTypeName( CAN_ERROR_TYPE( frame.mData1 ) );
+
         AddResultString( "E" );
         AddResultString( "Error" );
+
+        std::stringstream ss;
+        ss << "Error: " << type;
+        AddResultString( ss.str().c_str() );
+        ss << " at bit " << CAN_ERROR_BIT( frame.mData1 );
+        AddResultString( ss.str().c_str() );
+
+        if( CAN_ERROR_HAS_SUSPECT( frame.mData1 ) )
+        {
+            ss << ", bit " << CAN_ERROR_SUSPECT_BIT( frame.mData1 ) << " likely flipped";
+            AddResultString( ss.str().c_str() );
+        }
     }
     break;
     }
 }
 
 
-void CanAnalyzerResults::GenerateExportFile( const char* file, DisplayBase display_base, U32 /*export_type_user_id*/ )
+void CanAnalyzerResults::GenerateExportFile( const char* file, DisplayBase display_base, U32 export_type_user_id )
+{
+    switch( export_type_user_id )
+    {
+#ifdef CAN_DECODER_STATS
+    case DecoderStatsExport:
+        GenerateDecoderStatsExport( file );
+        break;
+#endif
+    case ColumnarExport:
+        GenerateColumnarExport( file );
+        break;
+    case BusLoadCsvExport:
+        GenerateBusLoadExport( file );
+        break;
+    case SummaryExport:
+        GenerateSummaryExport( file );
+        break;
+    case FrameCsvExport:
+    default:
+        GenerateFrameCsvExport( file, display_base );
+        break;
+    }
+}
+
+void CanAnalyzerResults::GenerateFrameCsvExport( const char* file, DisplayBase display_base )
 {
-    // export_type_user_id is only important if we have more than one export type.
-    std::stringstream ss;
     void* f = AnalyzerHelpers::StartFile( file );
 
     U64 trigger_sample = mAnalyzer->GetTriggerSample();
     U32 sample_rate = mAnalyzer->GetSampleRate();
 
-    ss << "Time [s],Packet,Type,Identifier,Control,Data,CRC,ACK" << std::endl;
-    U64 num_frames = GetNumFrames();
-    U64 num_packets = GetNumPackets();
-    for( U32 i = 0; i < num_packets; i++ )
-    {
-        if( i != 0 )
-        {
-            // below, we "continue" the loop rather than run to the end.  So we need to save to the file here.
-            ss << std::endl;
+    std::string text = "Time [s],Packet,Type,Identifier,Control,Data,CRC,ACK\n";
+    AnalyzerHelpers::AppendToFile( ( U8* )text.c_str(), text.length(), f );
+
+    CanExportSelection selection;
+    GetExportSelection( selection );
 
-            AnalyzerHelpers::AppendToFile( ( U8* )ss.str().c_str(), ss.str().length(), f );
-            ss.str( std::string() );
+    // this thread reads the frames of the packets, which are formatted on worker threads; it writes the chunks in order, and
+    // reports progress.
+    U64 num_packets = selection.mEndPacket - selection.mFirstPacket;
+    CanParallelExport chunks(
+        selection.mFirstPacket, selection.mEndPacket,
+        [&]( U64 first_packet, U64 end_packet, CanExportFrames& frames ) {
+            for( U64 i = first_packet; i < end_packet; i++ )
+            {
+                if( HasExportIdentifier( i, selection ) == false )
+                    continue;
+
+                U64 first_frame_id;
+                U64 last_frame_id;
+                GetFramesContainedInPacket( i, &first_frame_id, &last_frame_id );
 
+                CanExportPacket packet;
+                packet.mPacketId = i;
+                packet.mFirstFrame = frames.mFrames.size();
+                packet.mNumFrames = size_t( last_frame_id - first_frame_id + 1 );
+                frames.mPackets.push_back( packet );
 
-            if( UpdateExportProgressAndCheckForCancel( i, num_packets ) == true )
+                for( U64 frame_id = first_frame_id; frame_id <= last_frame_id; frame_id++ )
+                    frames.mFrames.push_back( GetFrame( frame_id ) );
+            }
+        },
+        [&]( const CanExportFrames& frames, std::string& chunk_text ) {
+            std::stringstream ss;
+            for( size_t i = 0; i < frames.mPackets.size(); i++ )
             {
-                AnalyzerHelpers::EndFile( f );
-                return;
+                const CanExportPacket& packet = frames.mPackets[ i ];
+                FormatCsvPacket( packet.mPacketId, &frames.mFrames[ packet.mFirstFrame ], packet.mNumFrames, display_base,
+                                 trigger_sample, sample_rate, ss );
+                ss << std::endl;
             }
+            chunk_text += ss.str();
+        } );
+
+    U64 end_packet;
+    while( chunks.GetNextChunk( text, end_packet ) == true )
+    {
+        AnalyzerHelpers::AppendToFile( ( U8* )text.c_str(), text.length(), f );
+
+        if( UpdateExportProgressAndCheckForCancel( end_packet - selection.mFirstPacket, num_packets ) == true )
+        {
+            AnalyzerHelpers::EndFile( f );
+            return;
         }
+    }
 
+    UpdateExportProgressAndCheckForCancel( num_packets, num_packets );
+    AnalyzerHelpers::EndFile( f );
+}
 
-        U64 first_frame_id;
-        U64 last_frame_id;
-        GetFramesContainedInPacket( i, &first_frame_id, &last_frame_id );
-        Frame frame = GetFrame( first_frame_id );
+// one row of the frame CSV export, without the line ending, from copies of the packet's frames. called from several threads
+// at once, so it doesn't touch the results.
+void CanAnalyzerResults::FormatCsvPacket( U64 packet_id, const Frame* frames, size_t num_frames, DisplayBase display_base,
+                                          U64 trigger_sample, U32 sample_rate, std::stringstream& ss )
+{
+    size_t first_frame_id = 0;
+    size_t last_frame_id = num_frames - 1;
+    Frame frame = frames[ first_frame_id ];
 
-        // static void GetTimeString( U64 sample, U64 trigger_sample, U32 sample_rate_hz, char* result_string, U32 result_string_max_length
-        // );
-        char time_str[ 128 ];
-        AnalyzerHelpers::GetTimeString( frame.mStartingSampleInclusive, trigger_sample, sample_rate, time_str, 128 );
+    // static void GetTimeString( U64 sample, U64 trigger_sample, U32 sample_rate_hz, char* result_string, U32 result_string_max_length
+    // );
+    char time_str[ 128 ];
+    AnalyzerHelpers::GetTimeString( frame.mStartingSampleInclusive, trigger_sample, sample_rate, time_str, 128 );
 
-        char packet_str[ 128 ];
-        AnalyzerHelpers::GetNumberString( i, Decimal, 0, packet_str, 128 );
+    char packet_str[ 128 ];
+    AnalyzerHelpers::GetNumberString( packet_id, Decimal, 0, packet_str, 128 );
 
-        if( frame.HasFlag( REMOTE_FRAME ) == false )
-            ss << time_str << "," << packet_str << ",DATA";
-        else
-            ss << time_str << "," << packet_str << ",REMOTE";
+    if( frame.HasFlag( REMOTE_FRAME ) == false )
+        ss << time_str << "," << packet_str << ",DATA";
+    else
+        ss << time_str << "," << packet_str << ",REMOTE";
 
-        U64 frame_id = first_frame_id;
+    size_t frame_id = first_frame_id;
 
-        frame = GetFrame( frame_id );
+    frame = frames[ frame_id ];
 
-        char number_str[ 128 ];
+    char number_str[ 128 ];
 
-        if( frame.mType == IdentifierField )
-        {
-            AnalyzerHelpers::GetNumberString( frame.mData1, display_base, 12, number_str, 128 );
-            ss << "," << number_str;
-            ++frame_id;
-        }
-        else if( frame.mType == IdentifierFieldEx )
-        {
-            AnalyzerHelpers::GetNumberString( frame.mData1, display_base, 32, number_str, 128 );
-            ss << "," << number_str;
+    if( frame.mType == IdentifierField )
+    {
+        AnalyzerHelpers::GetNumberString( frame.mData1, display_base, 12, number_str, 128 );
+        ss << "," << number_str;
+        ++frame_id;
+    }
+    else if( frame.mType == IdentifierFieldEx )
+    {
+        AnalyzerHelpers::GetNumberString( frame.mData1, display_base, 32, number_str, 128 );
+        ss << "," << number_str;
+        ++frame_id;
+    }
+    else
+    {
+        ss << ",";
+    }
+
+    // a reserved bit error that didn't end the frame has no column.
+    while( frame_id <= last_frame_id && frames[ frame_id ].mType == CanError )
+        ++frame_id;
+
+    if( frame_id > last_frame_id )
+        return;
+
+    frame = frames[ frame_id ];
+    if( frame.mType == ControlField )
+    {
+        AnalyzerHelpers::GetNumberString( frame.mData1, display_base, 4, number_str, 128 );
+        ss << "," << number_str;
+        ++frame_id;
+    }
+    else if( frame.mType == XlControlField )
+    {
+        // the CAN XL payload length; the preface CRC and the acceptance field have no column.
+        AnalyzerHelpers::GetNumberString( CAN_XL_DLC( frame.mData1 ) + 1, display_base, 12, number_str, 128 );
+        ss << "," << number_str;
+        ++frame_id;
+        while( frame_id <= last_frame_id && ( frames[ frame_id ].mType == XlPcrcField || frames[ frame_id ].mType == XlAddressField ) )
             ++frame_id;
-        }
+    }
+    else
+    {
+        ss << ",";
+    }
+    ss << ",";
+    if( frame_id > last_frame_id )
+        return;
+
+    for( ;; )
+    {
+        frame = frames[ frame_id ];
+        if( frame.mType != DataField )
+            break;
+
+        AnalyzerHelpers::GetNumberString( frame.mData1, display_base, 8, number_str, 128 );
+        ss << number_str;
+        if( frame_id == last_frame_id )
+            break;
+
+        ++frame_id;
+        if( frames[ frame_id ].mType == DataField )
+            ss << " ";
+    }
+
+    if( frame_id > last_frame_id )
+        return;
+
+    frame = frames[ frame_id ];
+    if( frame.mType == CrcField || frame.mType == XlFcrcField )
+    {
+        AnalyzerHelpers::GetNumberString( frame.mData1, display_base, frame.mType == CrcField ? 15 : 32, number_str, 128 );
+        ss << "," << number_str;
+        ++frame_id;
+    }
+    else
+    {
+        ss << ",";
+    }
+    if( frame_id > last_frame_id )
+        return;
+
+    frame = frames[ frame_id ];
+    if( frame.mType == AckField )
+    {
+        if( bool( frame.mData1 ) == true )
+            ss << ","
+               << "ACK";
         else
-        {
-            ss << ",";
-        }
+            ss << ","
+               << "NAK";
+
+        ++frame_id;
+    }
+    else
+    {
+        ss << ",";
+    }
+}
 
-        if( frame_id > last_frame_id )
-            continue;
+void CanAnalyzerResults::GenerateColumnarExport( const char* file )
+{
+    U64 trigger_sample = mAnalyzer->GetTriggerSample();
+    U32 sample_rate = mAnalyzer->GetSampleRate();
+    CanColumnarExport columns( file, &mAnalyzer->GetDbc() );
+    CanMessage message;
 
-        frame = GetFrame( frame_id );
-        if( frame.mType == ControlField )
+    CanExportSelection selection;
+    GetExportSelection( selection );
+
+    U64 num_packets = selection.mEndPacket - selection.mFirstPacket;
+    for( U64 i = selection.mFirstPacket; i < selection.mEndPacket; i++ )
+    {
+        if( GetPacketMessage( i, message ) == true && message.mRemoteFrame == false &&
+            ( selection.mIdentifiers.empty() ||
+              std::binary_search( selection.mIdentifiers.begin(), selection.mIdentifiers.end(),
+                                  message.mIdentifier | ( message.mExtended ? 0x80000000 : 0 ) ) ) )
         {
-            AnalyzerHelpers::GetNumberString( frame.mData1, display_base, 4, number_str, 128 );
-            ss << "," << number_str;
-            ++frame_id;
+            double time_s = ( double( message.mStartingSample ) - double( trigger_sample ) ) / double( sample_rate );
+            columns.AddMessage( time_s, message );
         }
-        else
+
+        // like the CSV exports, a cancelled export keeps what was written so far, so the column files still need their manifest.
+        if( UpdateExportProgressAndCheckForCancel( i - selection.mFirstPacket, num_packets ) == true )
         {
-            ss << ",";
+            columns.Finish( sample_rate );
+            return;
         }
-        ss << ",";
-        if( frame_id > last_frame_id )
-            continue;
+    }
 
-        for( ;; )
-        {
-            frame = GetFrame( frame_id );
-            if( frame.mType != DataField )
-                break;
+    columns.Finish( sample_rate );
+    UpdateExportProgressAndCheckForCancel( num_packets, num_packets );
+}
 
-            AnalyzerHelpers::GetNumberString( frame.mData1, display_base, 8, number_str, 128 );
-            ss << number_str;
-            if( frame_id == last_frame_id )
-                break;
+void CanAnalyzerResults::GenerateBusLoadExport( const char* file )
+{
+    std::stringstream ss;
+    void* f = AnalyzerHelpers::StartFile( file );
 
-            ++frame_id;
-            if( GetFrame( frame_id ).mType == DataField )
-                ss << " ";
-        }
+    U64 trigger_sample = mAnalyzer->GetTriggerSample();
+    U32 sample_rate = mAnalyzer->GetSampleRate();
+
+    std::vector<BusLoadWindow> windows;
+    {
+        std::lock_guard<std::mutex> lock( mBusLoadMutex );
+        windows = mBusLoad;
+        if( mHasOpenBusLoad == true )
+            windows.push_back( mOpenBusLoad ); // a partial window, with its own duration
+    }
 
-        if( frame_id > last_frame_id )
-            continue;
+    ss << "Time [s],Duration [s],Frames,Errors,Bits,Load [%]" << std::endl;
 
-        frame = GetFrame( frame_id );
-        if( frame.mType == CrcField )
+    U64 num_windows = windows.size();
+    for( U64 i = 0; i < num_windows; i++ )
+    {
+        const BusLoadWindow& window = windows[ i ];
+
+        char time_str[ 128 ];
+        AnalyzerHelpers::GetTimeString( window.mStartingSample, trigger_sample, sample_rate, time_str, 128 );
+
+        double duration_s = double( window.mEndingSample - window.mStartingSample + 1 ) / double( sample_rate );
+        double load = 100.0 * double( window.mBits ) / ( duration_s * double( mSettings->mBitRate ) );
+
+        ss << time_str << "," << duration_s << "," << window.mFrames << "," << window.mErrors << "," << window.mBits << "," << load
+           << std::endl;
+
+        AnalyzerHelpers::AppendToFile( ( U8* )ss.str().c_str(), ss.str().length(), f );
+        ss.str( std::string() );
+
+        if( UpdateExportProgressAndCheckForCancel( i, num_windows ) == true )
         {
-            AnalyzerHelpers::GetNumberString( frame.mData1, display_base, 15, number_str, 128 );
-            ss << "," << number_str;
-            ++frame_id;
+            AnalyzerHelpers::EndFile( f );
+            return;
         }
+    }
+
+    UpdateExportProgressAndCheckForCancel( num_windows, num_windows );
+    AnalyzerHelpers::EndFile( f );
+}
+
+void CanAnalyzerResults::AddBusLoadWindow( const BusLoadWindow& window )
+{
+    std::lock_guard<std::mutex> lock( mBusLoadMutex );
+    mBusLoad.push_back( window );
+    mHasOpenBusLoad = false;
+}
+
+void CanAnalyzerResults::SetOpenBusLoadWindow( const BusLoadWindow& window )
+{
+    std::lock_guard<std::mutex> lock( mBusLoadMutex );
+    mOpenBusLoad = window;
+    mHasOpenBusLoad = true;
+}
+
+void CanAnalyzerResults::GenerateSummaryExport( const char* file )
+{
+    std::stringstream ss;
+
+    U64 error_counts[ NumCanErrorTypes ];
+    std::map<U32, RemoteLatencyStats> remote_latency;
+    std::map<U64, GatewayLatencyStats> gateway_latency;
+    {
+        std::lock_guard<std::mutex> lock( mSummaryMutex );
+        memcpy( error_counts, mErrorCounts, sizeof( error_counts ) );
+        remote_latency = mRemoteLatency;
+        gateway_latency = mGatewayLatency;
+    }
+
+    ss << "Errors" << std::endl;
+    ss << "Type,Count" << std::endl;
+    for( U32 i = 0; i < NumCanErrorTypes; i++ )
+        ss << CanErrorTypeName( CanErrorType( i ) ) << "," << error_counts[ i ] << std::endl;
+    ss << std::endl;
+
+    ss << "Remote frame response latency" << std::endl;
+    ss << "Identifier,Extended,Requests,Responses,Min [s],Mean [s],Max [s]";
+    for( U32 i = 0; i < REMOTE_LATENCY_BINS - 1; i++ )
+        ss << ",<" << ( 2ull << i ) << " us";
+    ss << ",more" << std::endl;
+
+    for( std::map<U32, RemoteLatencyStats>::iterator it = remote_latency.begin(); it != remote_latency.end(); ++it )
+    {
+        const RemoteLatencyStats& stats = it->second;
+
+        char number_str[ 128 ];
+        AnalyzerHelpers::GetNumberString( stats.mIdentifier, Hexadecimal, stats.mExtended ? 32 : 12, number_str, 128 );
+        ss << number_str << "," << ( stats.mExtended ? "yes" : "no" ) << "," << stats.mRequests << "," << stats.mResponses;
+
+        if( stats.mResponses != 0 )
+            ss << "," << stats.mMinimum << "," << stats.mTotal / double( stats.mResponses ) << "," << stats.mMaximum;
         else
-        {
-            ss << ",";
-        }
-        if( frame_id > last_frame_id )
-            continue;
+            ss << ",,,";
 
-        frame = GetFrame( frame_id );
-        if( frame.mType == AckField )
+        for( U32 i = 0; i < REMOTE_LATENCY_BINS; i++ )
+            ss << "," << stats.mBins[ i ];
+        ss << std::endl;
+    }
+
+    if( mSettings->mGatewayChannel != UNDEFINED_CHANNEL )
+    {
+        ss << std::endl;
+        ss << "Gateway forwarding latency" << std::endl;
+        ss << "Identifier,Extended,Direction,Forwarded,Min [s],Mean [s],Max [s]" << std::endl;
+
+        for( std::map<U64, GatewayLatencyStats>::iterator it = gateway_latency.begin(); it != gateway_latency.end(); ++it )
         {
-            if( bool( frame.mData1 ) == true )
-                ss << ","
-                   << "ACK";
-            else
-                ss << ","
-                   << "NAK";
+            const GatewayLatencyStats& stats = it->second;
 
-            ++frame_id;
+            char number_str[ 128 ];
+            AnalyzerHelpers::GetNumberString( stats.mIdentifier, Hexadecimal, stats.mExtended ? 32 : 12, number_str, 128 );
+            ss << number_str << "," << ( stats.mExtended ? "yes" : "no" ) << "," << ( stats.mForwardedTo == GatewaySideB ? "A->B" : "B->A" )
+               << "," << stats.mForwarded << "," << stats.mMinimum << "," << stats.mTotal / double( stats.mForwarded ) << ","
+               << stats.mMaximum << std::endl;
         }
+    }
+
+    void* f = AnalyzerHelpers::StartFile( file );
+    AnalyzerHelpers::AppendToFile( ( U8* )ss.str().c_str(), ss.str().length(), f );
+    AnalyzerHelpers::EndFile( f );
+}
+
+void CanAnalyzerResults::AddRemoteRequest( U32 identifier, bool extended )
+{
+    std::lock_guard<std::mutex> lock( mSummaryMutex );
+    GetRemoteLatencyStats( identifier, extended ).mRequests++;
+}
+
+void CanAnalyzerResults::AddRemoteResponse( U32 identifier, bool extended, double latency_s )
+{
+    std::lock_guard<std::mutex> lock( mSummaryMutex );
+    RemoteLatencyStats& stats = GetRemoteLatencyStats( identifier, extended );
+
+    if( stats.mResponses == 0 || latency_s < stats.mMinimum )
+        stats.mMinimum = latency_s;
+    if( stats.mResponses == 0 || latency_s > stats.mMaximum )
+        stats.mMaximum = latency_s;
+    stats.mTotal += latency_s;
+    stats.mResponses++;
+
+    U32 bin = 0;
+    for( double limit = 2e-6; latency_s >= limit && bin < REMOTE_LATENCY_BINS - 1; limit *= 2.0 )
+        bin++;
+    stats.mBins[ bin ]++;
+}
+
+void CanAnalyzerResults::AddError( CanErrorType type )
+{
+    std::lock_guard<std::mutex> lock( mSummaryMutex );
+    mErrorCounts[ type ]++;
+}
+
+void CanAnalyzerResults::AddGatewayForward( U32 identifier, bool extended, GatewaySide forwarded_to, double latency_s )
+{
+    std::lock_guard<std::mutex> lock( mSummaryMutex );
+
+    U64 key = ( U64( forwarded_to ) << 32 ) | identifier | ( extended ? 0x80000000 : 0 );
+    std::map<U64, GatewayLatencyStats>::iterator it = mGatewayLatency.find( key );
+    if( it == mGatewayLatency.end() )
+    {
+        GatewayLatencyStats stats;
+        stats.mIdentifier = identifier;
+        stats.mExtended = extended;
+        stats.mForwardedTo = forwarded_to;
+        stats.mForwarded = 0;
+        stats.mMinimum = latency_s;
+        stats.mMaximum = latency_s;
+        stats.mTotal = 0.0;
+        it = mGatewayLatency.insert( std::make_pair( key, stats ) ).first;
+    }
+
+    GatewayLatencyStats& stats = it->second;
+    if( latency_s < stats.mMinimum )
+        stats.mMinimum = latency_s;
+    if( latency_s > stats.mMaximum )
+        stats.mMaximum = latency_s;
+    stats.mTotal += latency_s;
+    stats.mForwarded++;
+}
+
+RemoteLatencyStats& CanAnalyzerResults::GetRemoteLatencyStats( U32 identifier, bool extended )
+{
+    // callers hold mSummaryMutex.
+    U32 key = identifier | ( extended ? 0x80000000 : 0 );
+    std::map<U32, RemoteLatencyStats>::iterator it = mRemoteLatency.find( key );
+    if( it != mRemoteLatency.end() )
+        return it->second;
+
+    RemoteLatencyStats& stats = mRemoteLatency[ key ];
+    memset( &stats, 0, sizeof( stats ) );
+    stats.mIdentifier = identifier;
+    stats.mExtended = extended;
+    return stats;
+}
+
+void CanAnalyzerResults::GetExportSelection( CanExportSelection& selection )
+{
+    double trigger_sample = double( mAnalyzer->GetTriggerSample() );
+    double sample_rate = double( mAnalyzer->GetSampleRate() );
+
+    // packets are in order of their starting samples, so the time range is found with two binary searches.
+    selection.mFirstPacket = 0;
+    selection.mEndPacket = GetNumPackets();
+
+    double time_s;
+    if( ParseExportTime( mSettings->mExportStartTime, time_s ) == true )
+    {
+        double sample = std::ceil( trigger_sample + time_s * sample_rate );
+        selection.mFirstPacket = FindFirstPacketFrom( sample > 0.0 ? U64( sample ) : 0 );
+    }
+    if( ParseExportTime( mSettings->mExportEndTime, time_s ) == true )
+    {
+        double sample = std::floor( trigger_sample + time_s * sample_rate );
+        selection.mEndPacket = sample >= 0.0 ? FindFirstPacketFrom( U64( sample ) + 1 ) : 0;
+    }
+    if( selection.mEndPacket < selection.mFirstPacket )
+        selection.mEndPacket = selection.mFirstPacket;
+
+    ParseExportIdentifiers( mSettings->mExportIdentifiers, selection.mIdentifiers );
+}
+
+U64 CanAnalyzerResults::FindFirstPacketFrom( U64 sample )
+{
+    U64 low = 0;
+    U64 high = GetNumPackets();
+    while( low < high )
+    {
+        U64 middle = low + ( high - low ) / 2;
+
+        U64 first_frame_id;
+        U64 last_frame_id;
+        GetFramesContainedInPacket( middle, &first_frame_id, &last_frame_id );
+        if( U64( GetFrame( first_frame_id ).mStartingSampleInclusive ) < sample )
+            low = middle + 1;
         else
+            high = middle;
+    }
+
+    return low;
+}
+
+bool CanAnalyzerResults::HasExportIdentifier( U64 packet_id, const CanExportSelection& selection )
+{
+    if( selection.mIdentifiers.empty() )
+        return true;
+
+    U64 first_frame_id;
+    U64 last_frame_id;
+    GetFramesContainedInPacket( packet_id, &first_frame_id, &last_frame_id );
+    Frame frame = GetFrame( first_frame_id );
+    if( frame.mType != IdentifierField && frame.mType != IdentifierFieldEx )
+        return false;
+
+    U32 key = U32( frame.mData1 ) | ( frame.mType == IdentifierFieldEx ? 0x80000000 : 0 );
+    return std::binary_search( selection.mIdentifiers.begin(), selection.mIdentifiers.end(), key );
+}
+
+bool CanAnalyzerResults::GetPacketMessage( U64 packet_id, CanMessage& message )
+{
+    U64 first_frame_id;
+    U64 last_frame_id;
+    GetFramesContainedInPacket( packet_id, &first_frame_id, &last_frame_id );
+
+    Frame frame = GetFrame( first_frame_id );
+    if( frame.mType != IdentifierField && frame.mType != IdentifierFieldEx )
+        return false;
+
+    message.mIdentifier = U32( frame.mData1 );
+    message.mExtended = frame.mType == IdentifierFieldEx;
+    message.mRemoteFrame = frame.HasFlag( REMOTE_FRAME );
+    message.mDlc = 0;
+    message.mNumDataBytes = 0;
+    message.mPayloadHash = CAN_PAYLOAD_HASH_START;
+    message.mStartingSample = frame.mStartingSampleInclusive;
+    message.mEndingSample = frame.mEndingSampleInclusive;
+
+    for( U64 frame_id = first_frame_id + 1; frame_id <= last_frame_id; frame_id++ )
+    {
+        frame = GetFrame( frame_id );
+        if( frame.mType == ControlField )
+            message.mDlc = U32( frame.mData1 );
+        else if( frame.mType == XlControlField )
+            message.mDlc = CAN_XL_DLC( frame.mData1 );
+        else if( frame.mType == DataField )
         {
-            ss << ",";
+            if( message.mNumDataBytes < sizeof( message.mData ) )
+                message.mData[ message.mNumDataBytes++ ] = U8( frame.mData1 );
+            message.mPayloadHash = CAN_PAYLOAD_HASH( message.mPayloadHash, frame.mData1 );
         }
+        message.mEndingSample = frame.mEndingSampleInclusive;
     }
 
-    UpdateExportProgressAndCheckForCancel( num_frames, num_frames );
+    return true;
+}
+
+#ifdef CAN_DECODER_STATS
+void CanAnalyzerResults::GenerateDecoderStatsExport( const char* file )
+{
+    CanDecoderStats stats = mAnalyzer->GetDecoderStats();
+    double sampling_s = double( stats.mSamplingNs ) * 1e-9;
+    double emission_s = double( stats.mEmissionNs ) * 1e-9;
+    double total_s = sampling_s + emission_s;
+
+    std::stringstream ss;
+    ss << "Edges consumed," << stats.mEdgesConsumed << std::endl;
+    ss << "Channel seek calls," << stats.mChannelSeeks << std::endl;
+    ss << "Frames," << stats.mFrames << std::endl;
+    ss << "Stuff bits," << stats.mStuffBits << std::endl;
+    ss << "Errors," << stats.mErrors << std::endl;
+    ss << "Resync events," << stats.mResyncs << std::endl;
+    ss << "Glitches filtered," << stats.mGlitches << std::endl;
+    ss << "Sampling time [s]," << sampling_s << std::endl;
+    ss << "Emission time [s]," << emission_s << std::endl;
+
+    if( total_s > 0.0 )
+    {
+        ss << "Frames per second," << double( stats.mFrames ) / total_s << std::endl;
+        ss << "Edges per second," << double( stats.mEdgesConsumed ) / total_s << std::endl;
+    }
+
+    void* f = AnalyzerHelpers::StartFile( file );
+    AnalyzerHelpers::AppendToFile( ( U8* )ss.str().c_str(), ss.str().length(), f );
     AnalyzerHelpers::EndFile( f );
 }
+#endif
 
 void CanAnalyzerResults::GenerateFrameTabularText( U64 frame_index, DisplayBase display_base )
 {
@@ -316,6 +840,12 @@ void CanAnalyzerResults::GenerateFrameTabularText( U64 frame_index, DisplayBase
                 ss << "Extended CAN Identifier: " << number_str << " (RTR)";
         }
 
+        if( frame.HasFlag( XL_FRAME ) )
+            ss << " (XL)";
+
+        if( frame.mType == IdentifierFieldEx && mSettings->mJ1939 == true )
+            ss << " " << J1939Description( frame.mData1, display_base );
+
         AddTabularText( ss.str().c_str() );
     }
     break;
@@ -361,25 +891,176 @@ void CanAnalyzerResults::GenerateFrameTabularText( U64 frame_index, DisplayBase
             AddTabularText( "NAK" );
     }
     break;
+    case XlControlField:
+    {
+        char number_str[ 128 ];
+        AnalyzerHelpers::GetNumberString( CAN_XL_DLC( frame.mData1 ) + 1, display_base, 12, number_str, 128 );
+
+        std::stringstream ss;
+
+        ss << "XL Control Field: " << number_str << " bytes";
+        AnalyzerHelpers::GetNumberString( CAN_XL_SDT( frame.mData1 ), display_base, 8, number_str, 128 );
+        ss << ", SDT " << number_str;
+        if( CAN_XL_SEC( frame.mData1 ) != 0 )
+            ss << ", SEC";
+        AddTabularText( ss.str().c_str() );
+    }
+    break;
+    case XlPcrcField:
+    case XlFcrcField:
+    {
+        char number_str[ 128 ];
+        AnalyzerHelpers::GetNumberString( frame.mData1, display_base, frame.mType == XlPcrcField ? 13 : 32, number_str, 128 );
+
+        std::stringstream ss;
+
+        ss << ( frame.mType == XlPcrcField ? "Preface CRC value: " : "Frame CRC value: " ) << number_str;
+        AddTabularText( ss.str().c_str() );
+    }
+    break;
+    case XlAddressField:
+    {
+        char number_str[ 128 ];
+        AnalyzerHelpers::GetNumberString( CAN_XL_AF( frame.mData1 ), display_base, 32, number_str, 128 );
+
+        std::stringstream ss;
+
+        ss << "Acceptance Field: " << number_str;
+        AnalyzerHelpers::GetNumberString( CAN_XL_VCID( frame.mData1 ), display_base, 8, number_str, 128 );
+        ss << ", VCID " << number_str;
+        AddTabularText( ss.str().c_str() );
+    }
+    break;
     case CanError:
     {
-        AddTabularText( "Error" );
+        std::stringstream ss;
+        ss << "Error: " << CanErrorTypeName( CAN_ERROR_TYPE( frame.mData1 ) ) << " at bit " << CAN_ERROR_BIT( frame.mData1 );
+        if( CAN_ERROR_HAS_SUSPECT( frame.mData1 ) )
+            ss << ", bit " << CAN_ERROR_SUSPECT_BIT( frame.mData1 ) << " likely flipped";
+        AddTabularText( ss.str().c_str() );
     }
     break;
     }
 }
 
-void CanAnalyzerResults::GeneratePacketTabularText( U64 /*packet_id*/,
-                                                    DisplayBase /*display_base*/ ) // unrefereced vars commented out to remove warnings.
+void CanAnalyzerResults::GeneratePacketTabularText( U64 packet_id, DisplayBase display_base )
 {
-    ClearResultStrings();
-    AddResultString( "not supported" );
+    ClearTabularText();
+
+    U64 first_frame_id;
+    U64 last_frame_id;
+    GetFramesContainedInPacket( packet_id, &first_frame_id, &last_frame_id );
+
+    std::stringstream ss;
+    char number_str[ 128 ];
+    bool first_data_byte = true;
+
+    for( U64 frame_id = first_frame_id; frame_id <= last_frame_id; frame_id++ )
+    {
+        Frame frame = GetFrame( frame_id );
+
+        if( frame.mType == IdentifierField || frame.mType == IdentifierFieldEx )
+        {
+            AnalyzerHelpers::GetNumberString( frame.mData1, display_base, frame.mType == IdentifierField ? 12 : 32, number_str, 128 );
+            ss << "Id: " << number_str;
+            if( frame.HasFlag( REMOTE_FRAME ) == true )
+                ss << " (RTR)";
+            if( frame.HasFlag( XL_FRAME ) == true )
+                ss << " (XL)";
+        }
+        else if( frame.mType == DataField )
+        {
+            AnalyzerHelpers::GetNumberString( frame.mData1, display_base, 8, number_str, 128 );
+            ss << ( first_data_byte ? " Data: " : " " ) << number_str;
+            first_data_byte = false;
+        }
+        else if( frame.mType == AckField && bool( frame.mData1 ) == false )
+        {
+            ss << " NAK";
+        }
+        else if( frame.mType == CanError )
+        {
+            ss << " (" << CanErrorTypeName( CAN_ERROR_TYPE( frame.mData1 ) ) << " error)";
+        }
+    }
+
+    AddTabularText( ss.str().c_str() );
 }
 
-void
-    CanAnalyzerResults::GenerateTransactionTabularText( U64 /*transaction_id*/,
-                                                        DisplayBase /*display_base*/ ) // unrefereced vars commented out to remove warnings.
+void CanAnalyzerResults::GenerateTransactionTabularText( U64 transaction_id, DisplayBase display_base )
 {
-    ClearResultStrings();
-    AddResultString( "not supported" );
+    ClearTabularText();
+
+    IsoTpTransaction transaction;
+    {
+        std::lock_guard<std::mutex> lock( mTransactionsMutex );
+        if( transaction_id >= mIsoTpTransactions.size() )
+            return;
+        transaction = mIsoTpTransactions[ transaction_id ];
+    }
+
+    char number_str[ 128 ];
+    std::stringstream ss;
+
+    AnalyzerHelpers::GetNumberString( transaction.mSourceId, display_base, 32, number_str, 128 );
+    ss << "ISO-TP " << number_str;
+
+    if( transaction.mTargetId != ISOTP_UNKNOWN_ID )
+    {
+        AnalyzerHelpers::GetNumberString( transaction.mTargetId, display_base, 32, number_str, 128 );
+        ss << " -> " << number_str;
+    }
+
+    ss << ", " << transaction.mLength << " bytes:";
+
+    U32 count = transaction.mLeadingBytes.size();
+    for( U32 i = 0; i < count; i++ )
+    {
+        AnalyzerHelpers::GetNumberString( transaction.mLeadingBytes[ i ], display_base, 8, number_str, 128 );
+        ss << " " << number_str;
+    }
+
+    if( transaction.mLength > count )
+        ss << " ...";
+
+    AddTabularText( ss.str().c_str() );
+}
+
+std::string CanAnalyzerResults::J1939Description( U64 identifier, DisplayBase display_base )
+{
+    J1939Identifier id = J1939SplitIdentifier( U32( identifier ) );
+    char number_str[ 128 ];
+    std::stringstream ss;
+
+    AnalyzerHelpers::GetNumberString( id.mPgn, display_base, 18, number_str, 128 );
+    ss << "PGN: " << number_str;
+
+    const char* name = J1939PgnName( id.mPgn );
+    if( name != NULL )
+        ss << " (" << name << ")";
+
+    AnalyzerHelpers::GetNumberString( id.mSourceAddress, display_base, 8, number_str, 128 );
+    ss << " SA: " << number_str;
+
+    if( id.mDestinationAddress != J1939_GLOBAL_ADDRESS )
+    {
+        AnalyzerHelpers::GetNumberString( id.mDestinationAddress, display_base, 8, number_str, 128 );
+        ss << " DA: " << number_str;
+    }
+
+    ss << " P: " << U32( id.mPriority );
+    return ss.str();
+}
+
+U64 CanAnalyzerResults::AddIsoTpTransaction( U32 source_id, U32 target_id, const U8* data, U32 length )
+{
+    IsoTpTransaction transaction;
+    transaction.mSourceId = source_id;
+    transaction.mTargetId = target_id;
+    transaction.mLength = length;
+    transaction.mLeadingBytes.assign( data, data + ( length < ISOTP_TABULAR_BYTES ? length : ISOTP_TABULAR_BYTES ) );
+
+    std::lock_guard<std::mutex> lock( mTransactionsMutex );
+    mIsoTpTransactions.push_back( transaction );
+    return mIsoTpTransactions.size() - 1;
 }
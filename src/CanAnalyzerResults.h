@@ -2,6 +2,13 @@
 #define CAN_ANALYZER_RESULTS
 
 #include <AnalyzerResults.h>
+#include "CanMessage.h"
+#include "CanGateway.h"
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
 
 enum CanFrameType
 {
@@ -11,13 +18,113 @@ enum CanFrameType
     DataField,
     CrcField,
     AckField,
-    CanError
+    CanError,
+    XlControlField,
+    XlPcrcField,
+    XlAddressField,
+    XlFcrcField
 };
 #define REMOTE_FRAME ( 1 << 0 )
+#define XL_FRAME ( 1 << 1 ) // on the IdentifierField of a CAN XL frame
+
+// an XlControlField keeps the SDT in the low byte of mData1, the SEC bit above it, then the DLC (the payload is one byte longer)
+// and the stuff bit count.
+#define CAN_XL_CONTROL_DATA( sdt, sec, dlc, sbc ) ( U64( sdt ) | ( U64( sec ) << 8 ) | ( U64( dlc ) << 16 ) | ( U64( sbc ) << 32 ) )
+#define CAN_XL_SDT( data1 ) U32( ( data1 )&0xFF )
+#define CAN_XL_SEC( data1 ) U32( ( ( data1 ) >> 8 ) & 0x1 )
+#define CAN_XL_DLC( data1 ) U32( ( ( data1 ) >> 16 ) & 0x7FF )
+#define CAN_XL_SBC( data1 ) U32( ( ( data1 ) >> 32 ) & 0x7 )
+
+// an XlAddressField keeps the acceptance field in the low 32 bits of mData1, and the VCID above it.
+#define CAN_XL_ADDRESS_DATA( vcid, af ) ( U64( af ) | ( U64( vcid ) << 32 ) )
+#define CAN_XL_AF( data1 ) U32( ( data1 )&0xFFFFFFFF )
+#define CAN_XL_VCID( data1 ) U32( ( ( data1 ) >> 32 ) & 0xFF )
+
+// ISO 11898-1 error types.
+enum CanErrorType
+{
+    StuffError,
+    FormError, // CRC delimiter, ACK delimiter or end of frame not recessive, or the frame cut short
+    CrcError,
+    AckError,
+    ReservedBitError, // r0 (or r1) recessive
+    NumCanErrorTypes
+};
+
+// a CanError frame keeps the error type in the low byte of mData1, and the failing bit (counted from the start of frame,
+// stuff bits included) in the 16 bits above it, enough for the longest CAN XL frame.
+#define CAN_ERROR_DATA( type, bit ) ( ( U64( bit ) << 8 ) | U64( type ) )
+#define CAN_ERROR_TYPE( data1 ) CanErrorType( ( data1 )&0xFF )
+#define CAN_ERROR_BIT( data1 ) U32( ( ( data1 ) >> 8 ) & 0xFFFF )
+
+// a CRC error that one flipped bit would explain also keeps that bit (plus one, so 0 means none) in the next 16 bits, and
+// how many samples before the end of the error it was sampled in the top 24.
+#define CAN_ERROR_SUSPECT_MAX_SAMPLES_BEFORE 0xFFFFFF
+#define CAN_ERROR_SUSPECT_DATA( bit, samples_before ) ( ( ( U64( bit ) + 1 ) << 24 ) | ( U64( samples_before ) << 40 ) )
+#define CAN_ERROR_HAS_SUSPECT( data1 ) ( ( ( ( data1 ) >> 24 ) & 0xFFFF ) != 0 )
+#define CAN_ERROR_SUSPECT_BIT( data1 ) U32( ( ( ( data1 ) >> 24 ) & 0xFFFF ) - 1 )
+#define CAN_ERROR_SUSPECT_SAMPLES_BEFORE( data1 ) ( ( data1 ) >> 40 )
+
+const char* CanErrorTypeName( CanErrorType type );
 
 //#define FRAMING_ERROR_FLAG ( 1 << 0 )
 //#define PARITY_ERROR_FLAG ( 1 << 1 )
 
+// number of payload bytes kept per ISO-TP transaction for the tabular view.
+#define ISOTP_TABULAR_BYTES 32
+
+struct IsoTpTransaction
+{
+    U32 mSourceId;
+    U32 mTargetId;
+    U32 mLength;
+    std::vector<U8> mLeadingBytes;
+};
+
+// bits occupied on the bus during one bus load window.
+struct BusLoadWindow
+{
+    U64 mStartingSample;
+    U64 mEndingSample;
+    U64 mBits;
+    U32 mFrames;
+    U32 mErrors;
+};
+
+// response latency histogram bin i counts latencies below 2^(i+1) microseconds (the last bin counts the rest).
+#define REMOTE_LATENCY_BINS 24
+
+struct RemoteLatencyStats
+{
+    U32 mIdentifier;
+    bool mExtended;
+    U64 mRequests;
+    U64 mResponses;
+    double mMinimum;
+    double mMaximum;
+    double mTotal;
+    U64 mBins[ REMOTE_LATENCY_BINS ];
+};
+
+struct GatewayLatencyStats
+{
+    U32 mIdentifier;
+    bool mExtended;
+    GatewaySide mForwardedTo;
+    U64 mForwarded;
+    double mMinimum;
+    double mMaximum;
+    double mTotal;
+};
+
+// the packets an export covers: those that start within the export time range and, when identifiers are set, have one of them.
+struct CanExportSelection
+{
+    U64 mFirstPacket;
+    U64 mEndPacket;
+    std::vector<U32> mIdentifiers; // sorted, bit 31 set when extended; empty for every identifier
+};
+
 class CanAnalyzer;
 class CanAnalyzerSettings;
 
@@ -34,10 +141,47 @@ class CanAnalyzerResults : public AnalyzerResults
     virtual void GeneratePacketTabularText( U64 packet_id, DisplayBase display_base );
     virtual void GenerateTransactionTabularText( U64 transaction_id, DisplayBase display_base );
 
+    U64 AddIsoTpTransaction( U32 source_id, U32 target_id, const U8* data, U32 length );
+    bool GetPacketMessage( U64 packet_id, CanMessage& message );
+    void AddBusLoadWindow( const BusLoadWindow& window );
+    void SetOpenBusLoadWindow( const BusLoadWindow& window ); // the window still being counted, up to where decoding has got
+    void AddRemoteRequest( U32 identifier, bool extended );
+    void AddRemoteResponse( U32 identifier, bool extended, double latency_s );
+    void AddGatewayForward( U32 identifier, bool extended, GatewaySide forwarded_to, double latency_s );
+    void AddError( CanErrorType type );
+
   protected: // functions
+    std::string J1939Description( U64 identifier, DisplayBase display_base );
+    void GenerateFrameCsvExport( const char* file, DisplayBase display_base );
+    void FormatCsvPacket( U64 packet_id, const Frame* frames, size_t num_frames, DisplayBase display_base, U64 trigger_sample,
+                          U32 sample_rate, std::stringstream& ss );
+    void GetExportSelection( CanExportSelection& selection );
+    U64 FindFirstPacketFrom( U64 sample ); // GetNumPackets() if every packet starts before sample
+    bool HasExportIdentifier( U64 packet_id, const CanExportSelection& selection );
+    void GenerateColumnarExport( const char* file );
+    void GenerateBusLoadExport( const char* file );
+    void GenerateSummaryExport( const char* file );
+    RemoteLatencyStats& GetRemoteLatencyStats( U32 identifier, bool extended );
+#ifdef CAN_DECODER_STATS
+    void GenerateDecoderStatsExport( const char* file );
+#endif
+
   protected: // vars
     CanAnalyzerSettings* mSettings;
     CanAnalyzer* mAnalyzer;
+
+    std::mutex mTransactionsMutex;
+    std::vector<IsoTpTransaction> mIsoTpTransactions;
+
+    std::mutex mBusLoadMutex;
+    std::vector<BusLoadWindow> mBusLoad;
+    BusLoadWindow mOpenBusLoad;
+    bool mHasOpenBusLoad;
+
+    std::mutex mSummaryMutex;
+    U64 mErrorCounts[ NumCanErrorTypes ];
+    std::map<U32, RemoteLatencyStats> mRemoteLatency; // keyed by identifier, bit 31 set when extended
+    std::map<U64, GatewayLatencyStats> mGatewayLatency; // keyed as above, with the forwarding side above bit 32
 };
 
 #endif // CAN_ANALYZER_RESULTS
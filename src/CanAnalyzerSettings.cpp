@@ -1,10 +1,26 @@
 #include "CanAnalyzerSettings.h"
+#include "CanDbc.h"
 
 #include <AnalyzerHelpers.h>
 #include <sstream>
 #include <cstring>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 
-CanAnalyzerSettings::CanAnalyzerSettings() : mCanChannel( UNDEFINED_CHANNEL ), mBitRate( 1000000 ), mInverted( false )
+CanAnalyzerSettings::CanAnalyzerSettings()
+    : mCanChannel( UNDEFINED_CHANNEL ),
+      mBitRate( 1000000 ),
+      mInverted( false ),
+      mCommitPolicy( CommitBatched ),
+      mIsoTp( false ),
+      mJ1939( false ),
+      mBusLoadWindowMs( 0 ),
+      mCycleTimeMultiple( 0.0 ),
+      mRemoteLatency( false ),
+      mGatewayChannel( UNDEFINED_CHANNEL ),
+      mGlitchFilterNs( 0 ),
+      mXlDataBitRate( 0 )
 {
     mCanChannelInterface.reset( new AnalyzerSettingInterfaceChannel() );
     mCanChannelInterface->SetTitleAndTooltip( "CAN", "Controller Area Network - Input" );
@@ -21,18 +37,159 @@ CanAnalyzerSettings::CanAnalyzerSettings() : mCanChannel( UNDEFINED_CHANNEL ), m
     mCanChannelInvertedInterface->SetCheckBoxText( "Inverted (CAN High)" );
     mCanChannelInvertedInterface->SetValue( mInverted );
 
+    mCommitPolicyInterface.reset( new AnalyzerSettingInterfaceNumberList() );
+    mCommitPolicyInterface->SetTitleAndTooltip( "Result updates", "How often decoded results are handed to the display" );
+    mCommitPolicyInterface->AddNumber( CommitBatched, "Batched (fastest analysis)",
+                                       "Publish results in batches of frames; best for saved captures" );
+    mCommitPolicyInterface->AddNumber( CommitEveryFrame, "Every frame (lowest latency)",
+                                       "Publish every frame as soon as it is decoded; best for watching live captures" );
+    mCommitPolicyInterface->SetNumber( mCommitPolicy );
+
+    mCacheFolderInterface.reset( new AnalyzerSettingInterfaceText() );
+    mCacheFolderInterface->SetTitleAndTooltip( "Results cache folder",
+                                               "Optional. Decoded results are cached here and reused when the same capture is analyzed "
+                                               "again with the same settings. Leave empty to disable." );
+    mCacheFolderInterface->SetTextType( AnalyzerSettingInterfaceText::FolderPath );
+    mCacheFolderInterface->SetText( mCacheFolder.c_str() );
+
+    mIsoTpInterface.reset( new AnalyzerSettingInterfaceBool() );
+    mIsoTpInterface->SetTitleAndTooltip( "", "Reassemble ISO-TP (ISO 15765-2) single and multi-frame transfers into transactions" );
+    mIsoTpInterface->SetCheckBoxText( "Decode ISO-TP" );
+    mIsoTpInterface->SetValue( mIsoTp );
+
+    mJ1939Interface.reset( new AnalyzerSettingInterfaceBool() );
+    mJ1939Interface->SetTitleAndTooltip(
+        "", "Split extended identifiers into priority, PGN and addresses, and reassemble TP.BAM and TP.CM/DT transfers" );
+    mJ1939Interface->SetCheckBoxText( "Decode J1939" );
+    mJ1939Interface->SetValue( mJ1939 );
+
+    mDbcPathInterface.reset( new AnalyzerSettingInterfaceText() );
+    mDbcPathInterface->SetTitleAndTooltip( "DBC file",
+                                           "Optional. Signals defined in this DBC file are decoded from each matching message." );
+    mDbcPathInterface->SetTextType( AnalyzerSettingInterfaceText::FilePath );
+    mDbcPathInterface->SetText( mDbcPath.c_str() );
+
+    mBusLoadWindowInterface.reset( new AnalyzerSettingInterfaceInteger() );
+    mBusLoadWindowInterface->SetTitleAndTooltip( "Bus load window (ms)",
+                                                 "Report the bus load over consecutive windows of this length. Set to 0 to disable." );
+    mBusLoadWindowInterface->SetMax( 60000 );
+    mBusLoadWindowInterface->SetMin( 0 );
+    mBusLoadWindowInterface->SetInteger( mBusLoadWindowMs );
+
+    mCycleTimeInterface.reset( new AnalyzerSettingInterfaceNumberList() );
+    mCycleTimeInterface->SetTitleAndTooltip( "Cycle time violations",
+                                             "Learn the period of each identifier and report frames that arrive later than this multiple "
+                                             "of it, or not at all" );
+    mCycleTimeInterface->AddNumber( 0.0, "Off", "Don't check cycle times" );
+    mCycleTimeInterface->AddNumber( 1.5, "Later than 1.5x the period", "Report frames more than 50% late" );
+    mCycleTimeInterface->AddNumber( 2.0, "Later than 2x the period", "Report a frame when one transmission was skipped" );
+    mCycleTimeInterface->AddNumber( 3.0, "Later than 3x the period", "Report a frame when two transmissions were skipped" );
+    mCycleTimeInterface->AddNumber( 5.0, "Later than 5x the period", "Report only long outages" );
+    mCycleTimeInterface->SetNumber( mCycleTimeMultiple );
+
+    mRemoteLatencyInterface.reset( new AnalyzerSettingInterfaceBool() );
+    mRemoteLatencyInterface->SetTitleAndTooltip(
+        "", "Match each remote frame to the next data frame with the same identifier and DLC, and measure the response time" );
+    mRemoteLatencyInterface->SetCheckBoxText( "Measure remote frame response latency" );
+    mRemoteLatencyInterface->SetValue( mRemoteLatency );
+
+    mGatewayChannelInterface.reset( new AnalyzerSettingInterfaceChannel() );
+    mGatewayChannelInterface->SetTitleAndTooltip( "CAN (gateway side)",
+                                                  "Optional. A second bus connected through a gateway; messages forwarded between the two "
+                                                  "buses are matched and their forwarding latency is measured." );
+    mGatewayChannelInterface->SetChannel( mGatewayChannel );
+    mGatewayChannelInterface->SetSelectionOfNoneIsAllowed( true );
+
+    mGlitchFilterInterface.reset( new AnalyzerSettingInterfaceInteger() );
+    mGlitchFilterInterface->SetTitleAndTooltip( "Glitch filter (ns)",
+                                                "Ignore pulses shorter than this on a noisy bus. Must be less than half a bit time. "
+                                                "Set to 0 to disable." );
+    mGlitchFilterInterface->SetMax( 50000 );
+    mGlitchFilterInterface->SetMin( 0 );
+    mGlitchFilterInterface->SetInteger( mGlitchFilterNs );
+
+    mXlDataBitRateInterface.reset( new AnalyzerSettingInterfaceInteger() );
+    mXlDataBitRateInterface->SetTitleAndTooltip( "CAN XL data bit rate (Bits/s)",
+                                                 "The bit rate of the data phase of CAN XL frames. Set to 0 to decode classical CAN only." );
+    mXlDataBitRateInterface->SetMax( 20000000 );
+    mXlDataBitRateInterface->SetMin( 0 );
+    mXlDataBitRateInterface->SetInteger( mXlDataBitRate );
+
+    mLiveFeedNameInterface.reset( new AnalyzerSettingInterfaceText() );
+    mLiveFeedNameInterface->SetTitleAndTooltip( "Live feed shared memory name",
+                                                "Optional. Each decoded message is also published to a POSIX shared memory segment with "
+                                                "this name, like /can_live, for local programs to follow. Leave empty to disable." );
+    mLiveFeedNameInterface->SetText( mLiveFeedName.c_str() );
+
+    mReplayLogPathInterface.reset( new AnalyzerSettingInterfaceText() );
+    mReplayLogPathInterface->SetTitleAndTooltip( "Simulation log file",
+                                                 "Optional. In simulation, replay the frames of this candump (-l) or Vector ASC log with "
+                                                 "their original timing instead of the built-in test frames." );
+    mReplayLogPathInterface->SetTextType( AnalyzerSettingInterfaceText::FilePath );
+    mReplayLogPathInterface->SetText( mReplayLogPath.c_str() );
+
+    mExportStartTimeInterface.reset( new AnalyzerSettingInterfaceText() );
+    mExportStartTimeInterface->SetTitleAndTooltip( "Export from (s)",
+                                                   "Optional. The frame and columnar exports start with the first packet at or after "
+                                                   "this time, in seconds from the trigger. Changing it re-runs the analysis." );
+    mExportStartTimeInterface->SetText( mExportStartTime.c_str() );
+
+    mExportEndTimeInterface.reset( new AnalyzerSettingInterfaceText() );
+    mExportEndTimeInterface->SetTitleAndTooltip( "Export to (s)",
+                                                 "Optional. The frame and columnar exports stop after the last packet that starts at or "
+                                                 "before this time, in seconds from the trigger. Changing it re-runs the analysis." );
+    mExportEndTimeInterface->SetText( mExportEndTime.c_str() );
+
+    mExportIdentifiersInterface.reset( new AnalyzerSettingInterfaceText() );
+    mExportIdentifiersInterface->SetTitleAndTooltip( "Export identifiers",
+                                                     "Optional. Hex identifiers separated by commas, like 0x123, 18FEF100; the frame and "
+                                                     "columnar exports only include these. Up to 3 digits is an 11-bit identifier, more "
+                                                     "is a 29-bit one. Leave empty to export every identifier. Changing it re-runs the "
+                                                     "analysis." );
+    mExportIdentifiersInterface->SetText( mExportIdentifiers.c_str() );
 
     AddInterface( mCanChannelInterface.get() );
+    AddInterface( mGatewayChannelInterface.get() );
     AddInterface( mBitRateInterface.get() );
+    AddInterface( mXlDataBitRateInterface.get() );
     AddInterface( mCanChannelInvertedInterface.get() );
+    AddInterface( mGlitchFilterInterface.get() );
+    AddInterface( mCommitPolicyInterface.get() );
+    AddInterface( mCacheFolderInterface.get() );
+    AddInterface( mIsoTpInterface.get() );
+    AddInterface( mJ1939Interface.get() );
+    AddInterface( mDbcPathInterface.get() );
+    AddInterface( mBusLoadWindowInterface.get() );
+    AddInterface( mCycleTimeInterface.get() );
+    AddInterface( mRemoteLatencyInterface.get() );
+#ifndef _WIN32
+    AddInterface( mLiveFeedNameInterface.get() );
+#endif
+    AddInterface( mReplayLogPathInterface.get() );
+    AddInterface( mExportStartTimeInterface.get() );
+    AddInterface( mExportEndTimeInterface.get() );
+    AddInterface( mExportIdentifiersInterface.get() );
 
     // AddExportOption( 0, "Export as text/csv file", "text (*.txt);;csv (*.csv)" );
-    AddExportOption( 0, "Export as text/csv file" );
-    AddExportExtension( 0, "text", "txt" );
-    AddExportExtension( 0, "csv", "csv" );
+    AddExportOption( FrameCsvExport, "Export as text/csv file" );
+    AddExportExtension( FrameCsvExport, "text", "txt" );
+    AddExportExtension( FrameCsvExport, "csv", "csv" );
 
-    ClearChannels();
-    AddChannel( mCanChannel, "CAN", false );
+    AddExportOption( ColumnarExport, "Export as columnar time series (NumPy/Arrow)" );
+    AddExportExtension( ColumnarExport, "json manifest", "json" );
+
+    AddExportOption( BusLoadCsvExport, "Export bus load timeline" );
+    AddExportExtension( BusLoadCsvExport, "csv", "csv" );
+
+    AddExportOption( SummaryExport, "Export summary report" );
+    AddExportExtension( SummaryExport, "csv", "csv" );
+
+#ifdef CAN_DECODER_STATS
+    AddExportOption( DecoderStatsExport, "Export decoder statistics" );
+    AddExportExtension( DecoderStatsExport, "text", "txt" );
+#endif
+
+    UpdateChannels( false );
 }
 
 CanAnalyzerSettings::~CanAnalyzerSettings()
@@ -48,12 +205,112 @@ bool CanAnalyzerSettings::SetSettingsFromInterfaces()
         SetErrorText( "Please select a channel for the CAN interface" );
         return false;
     }
+
+    Channel gateway_channel = mGatewayChannelInterface->GetChannel();
+    if( gateway_channel == can_channel )
+    {
+        SetErrorText( "The gateway side must be on a different channel than the CAN interface" );
+        return false;
+    }
+
+    U32 bit_rate = mBitRateInterface->GetInteger();
+    U32 xl_data_bit_rate = mXlDataBitRateInterface->GetInteger();
+    if( xl_data_bit_rate != 0 && xl_data_bit_rate < bit_rate )
+    {
+        SetErrorText( "The CAN XL data bit rate can't be lower than the bit rate" );
+        return false;
+    }
+
+    U32 glitch_filter_ns = mGlitchFilterInterface->GetInteger();
+    if( double( glitch_filter_ns ) * 1e-9 >= 0.5 / double( xl_data_bit_rate > bit_rate ? xl_data_bit_rate : bit_rate ) )
+    {
+        SetErrorText( "The glitch filter must be shorter than half a bit time" );
+        return false;
+    }
+
+    std::string dbc_path = mDbcPathInterface->GetText();
+    if( dbc_path.empty() == false )
+    {
+        // the analysis has no way to report a bad file, so it's loaded here once to check it.
+        CanDbc dbc;
+        if( dbc.Load( dbc_path ) == false )
+        {
+            SetErrorText( "Unable to open the DBC file" );
+            return false;
+        }
+        if( dbc.IsLoaded() == false )
+        {
+            SetErrorText( "The DBC file defines no messages" );
+            return false;
+        }
+    }
+
+    std::string replay_log_path = mReplayLogPathInterface->GetText();
+    if( replay_log_path.empty() == false )
+    {
+        FILE* replay_log_file = fopen( replay_log_path.c_str(), "r" );
+        if( replay_log_file == NULL )
+        {
+            SetErrorText( "Unable to open the simulation log file" );
+            return false;
+        }
+        fclose( replay_log_file );
+    }
+
+    std::string export_start_time = mExportStartTimeInterface->GetText();
+    std::string export_end_time = mExportEndTimeInterface->GetText();
+    double export_start_s = 0.0;
+    double export_end_s = 0.0;
+    if( ( export_start_time.empty() == false && ParseExportTime( export_start_time, export_start_s ) == false ) ||
+        ( export_end_time.empty() == false && ParseExportTime( export_end_time, export_end_s ) == false ) )
+    {
+        SetErrorText( "The export times must be numbers of seconds, like 12.5" );
+        return false;
+    }
+    if( export_start_time.empty() == false && export_end_time.empty() == false && export_end_s < export_start_s )
+    {
+        SetErrorText( "The export can't end before it starts" );
+        return false;
+    }
+
+    std::string export_identifiers = mExportIdentifiersInterface->GetText();
+    std::vector<U32> identifiers;
+    if( ParseExportIdentifiers( export_identifiers, identifiers ) == false )
+    {
+        SetErrorText( "The export identifiers must be hex numbers separated by commas, like 0x123, 18FEF100, and 11-bit ones at most 7FF" );
+        return false;
+    }
+
+    // a portable shm_open name is a slash followed by at most 254 characters, none of them slashes.
+    std::string live_feed_name = mLiveFeedNameInterface->GetText();
+    if( live_feed_name.empty() == false &&
+        ( live_feed_name[ 0 ] != '/' || live_feed_name.find( '/', 1 ) != std::string::npos || live_feed_name.size() > 255 ) )
+    {
+        SetErrorText( "The live feed name must start with a slash and contain no other slashes, like /can_live" );
+        return false;
+    }
+
     mCanChannel = can_channel;
-    mBitRate = mBitRateInterface->GetInteger();
+    mBitRate = bit_rate;
     mInverted = mCanChannelInvertedInterface->GetValue();
+    mCommitPolicy = U32( mCommitPolicyInterface->GetNumber() );
+    mCacheFolder = mCacheFolderInterface->GetText();
+    mIsoTp = mIsoTpInterface->GetValue();
+    mJ1939 = mJ1939Interface->GetValue();
+    mDbcPath = dbc_path;
+    mBusLoadWindowMs = mBusLoadWindowInterface->GetInteger();
+    mCycleTimeMultiple = mCycleTimeInterface->GetNumber();
+    mRemoteLatency = mRemoteLatencyInterface->GetValue();
+    mGatewayChannel = gateway_channel;
+    mGlitchFilterNs = glitch_filter_ns;
+    mXlDataBitRate = xl_data_bit_rate;
+    mLiveFeedName = live_feed_name;
+    mReplayLogPath = replay_log_path;
+    mExportStartTime = export_start_time;
+    mExportEndTime = export_end_time;
+    mExportIdentifiers = export_identifiers;
 
-    ClearChannels();
-    AddChannel( mCanChannel, "CAN", true );
+    UpdateChannels( true );
 
     return true;
 }
@@ -71,9 +328,43 @@ void CanAnalyzerSettings::LoadSettings( const char* settings )
     text_archive >> mCanChannel;
     text_archive >> mBitRate;
     text_archive >> mInverted; // SimpleArchive catches exception and returns false if it fails.
+    text_archive >> mCommitPolicy;
 
-    ClearChannels();
-    AddChannel( mCanChannel, "CAN", true );
+    const char* cache_folder;
+    if( text_archive >> &cache_folder )
+        mCacheFolder = cache_folder;
+    text_archive >> mIsoTp;
+    text_archive >> mJ1939;
+
+    const char* dbc_path;
+    if( text_archive >> &dbc_path )
+        mDbcPath = dbc_path;
+    text_archive >> mBusLoadWindowMs;
+    text_archive >> mCycleTimeMultiple;
+    text_archive >> mRemoteLatency;
+    text_archive >> mGatewayChannel;
+    text_archive >> mGlitchFilterNs;
+    text_archive >> mXlDataBitRate;
+
+    const char* live_feed_name;
+    if( text_archive >> &live_feed_name )
+        mLiveFeedName = live_feed_name;
+
+    const char* replay_log_path;
+    if( text_archive >> &replay_log_path )
+        mReplayLogPath = replay_log_path;
+
+    const char* export_start_time;
+    if( text_archive >> &export_start_time )
+        mExportStartTime = export_start_time;
+    const char* export_end_time;
+    if( text_archive >> &export_end_time )
+        mExportEndTime = export_end_time;
+    const char* export_identifiers;
+    if( text_archive >> &export_identifiers )
+        mExportIdentifiers = export_identifiers;
+
+    UpdateChannels( true );
 
     UpdateInterfacesFromSettings();
 }
@@ -86,16 +377,75 @@ const char* CanAnalyzerSettings::SaveSettings()
     text_archive << mCanChannel;
     text_archive << mBitRate;
     text_archive << mInverted;
+    text_archive << mCommitPolicy;
+    text_archive << mCacheFolder.c_str();
+    text_archive << mIsoTp;
+    text_archive << mJ1939;
+    text_archive << mDbcPath.c_str();
+    text_archive << mBusLoadWindowMs;
+    text_archive << mCycleTimeMultiple;
+    text_archive << mRemoteLatency;
+    text_archive << mGatewayChannel;
+    text_archive << mGlitchFilterNs;
+    text_archive << mXlDataBitRate;
+    text_archive << mLiveFeedName.c_str();
+    text_archive << mReplayLogPath.c_str();
+
+    // the export filters are only saved to keep them with the session. they don't change the analysis, and GetDecodeSettings
+    // leaves them out of the results cache key, but the SDK has no options of its own for an export, so changing them in the
+    // settings still re-runs the analysis; with a cache folder set, that run replays the cached frames.
+    text_archive << mExportStartTime.c_str();
+    text_archive << mExportEndTime.c_str();
+    text_archive << mExportIdentifiers.c_str();
 
 
     return SetReturnString( text_archive.GetString() );
 }
 
+std::string CanAnalyzerSettings::GetDecodeSettings()
+{
+    // everything else (ISO-TP, J1939, DBC, bus load, cycle times, latencies, the gateway side and the exports) is worked out
+    // again from the cached frames, and the rest doesn't touch the results at all.
+    SimpleArchive text_archive;
+
+    text_archive << "SaleaeCANAnalyzer";
+    text_archive << mCanChannel;
+    text_archive << mBitRate;
+    text_archive << mInverted;
+    text_archive << mGlitchFilterNs;
+    text_archive << mXlDataBitRate;
+
+    return text_archive.GetString();
+}
+
 void CanAnalyzerSettings::UpdateInterfacesFromSettings()
 {
     mCanChannelInterface->SetChannel( mCanChannel );
     mBitRateInterface->SetInteger( mBitRate );
     mCanChannelInvertedInterface->SetValue( mInverted );
+    mCommitPolicyInterface->SetNumber( mCommitPolicy );
+    mCacheFolderInterface->SetText( mCacheFolder.c_str() );
+    mIsoTpInterface->SetValue( mIsoTp );
+    mJ1939Interface->SetValue( mJ1939 );
+    mDbcPathInterface->SetText( mDbcPath.c_str() );
+    mBusLoadWindowInterface->SetInteger( mBusLoadWindowMs );
+    mCycleTimeInterface->SetNumber( mCycleTimeMultiple );
+    mRemoteLatencyInterface->SetValue( mRemoteLatency );
+    mGatewayChannelInterface->SetChannel( mGatewayChannel );
+    mGlitchFilterInterface->SetInteger( mGlitchFilterNs );
+    mXlDataBitRateInterface->SetInteger( mXlDataBitRate );
+    mLiveFeedNameInterface->SetText( mLiveFeedName.c_str() );
+    mReplayLogPathInterface->SetText( mReplayLogPath.c_str() );
+    mExportStartTimeInterface->SetText( mExportStartTime.c_str() );
+    mExportEndTimeInterface->SetText( mExportEndTime.c_str() );
+    mExportIdentifiersInterface->SetText( mExportIdentifiers.c_str() );
+}
+
+void CanAnalyzerSettings::UpdateChannels( bool is_used )
+{
+    ClearChannels();
+    AddChannel( mCanChannel, "CAN", is_used );
+    AddChannel( mGatewayChannel, "CAN (gateway side)", is_used && mGatewayChannel != UNDEFINED_CHANNEL );
 }
 
 BitState CanAnalyzerSettings::Recessive()
@@ -110,3 +460,45 @@ BitState CanAnalyzerSettings::Dominant()
         return BIT_HIGH;
     return BIT_LOW;
 }
+
+bool ParseExportTime( const std::string& text, double& time_s )
+{
+    const char* start = text.c_str();
+    char* end;
+    time_s = strtod( start, &end );
+    while( *end == ' ' )
+        end++;
+    return end != start && *end == 0;
+}
+
+bool ParseExportIdentifiers( const std::string& text, std::vector<U32>& identifiers )
+{
+    identifiers.clear();
+
+    const char* p = text.c_str();
+    for( ;; )
+    {
+        while( *p == ' ' || *p == ',' )
+            p++;
+        if( *p == 0 )
+            break;
+
+        char* end;
+        unsigned long identifier = strtoul( p, &end, 16 );
+        if( end == p || ( *end != 0 && *end != ' ' && *end != ',' ) || identifier > 0x1FFFFFFF )
+            return false;
+
+        // like candump, up to 3 hex digits is an 11-bit identifier and more is a 29-bit one; the key has bit 31 set when extended.
+        long num_digits = long( end - p );
+        if( p[ 0 ] == '0' && ( p[ 1 ] == 'x' || p[ 1 ] == 'X' ) )
+            num_digits -= 2;
+        if( num_digits <= 3 && identifier > 0x7FF )
+            return false;
+
+        identifiers.push_back( U32( identifier ) | ( num_digits > 3 ? 0x80000000 : 0 ) );
+        p = end;
+    }
+
+    std::sort( identifiers.begin(), identifiers.end() );
+    return true;
+}
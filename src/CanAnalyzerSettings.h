@@ -3,10 +3,27 @@
 
 #include <AnalyzerSettings.h>
 #include <AnalyzerTypes.h>
+#include <string>
+#include <vector>
 
 //#define RECESSIVE BIT_HIGH
 //#define DOMINANT BIT_LOW
 
+enum CanExportType
+{
+    FrameCsvExport,
+    DecoderStatsExport,
+    ColumnarExport,
+    BusLoadCsvExport,
+    SummaryExport
+};
+
+enum CanCommitPolicy
+{
+    CommitEveryFrame, // low latency, for watching live captures
+    CommitBatched     // high throughput, for offline analysis
+};
+
 class CanAnalyzerSettings : public AnalyzerSettings
 {
   public:
@@ -18,10 +35,27 @@ class CanAnalyzerSettings : public AnalyzerSettings
     virtual const char* SaveSettings();
 
     void UpdateInterfacesFromSettings();
+    std::string GetDecodeSettings(); // only the settings that change the decoded frames, for the results cache key
 
     Channel mCanChannel;
     U32 mBitRate;
     bool mInverted;
+    U32 mCommitPolicy;
+    std::string mCacheFolder;
+    bool mIsoTp;
+    bool mJ1939;
+    std::string mDbcPath;
+    U32 mBusLoadWindowMs;
+    double mCycleTimeMultiple; // 0 when cycle times aren't checked
+    bool mRemoteLatency;
+    Channel mGatewayChannel; // UNDEFINED_CHANNEL when forwarding latency isn't measured
+    U32 mGlitchFilterNs;
+    U32 mXlDataBitRate; // 0 when CAN XL frames aren't decoded
+    std::string mLiveFeedName; // empty when decoded messages aren't published
+    std::string mReplayLogPath; // empty when the simulation sends its built-in frames
+    std::string mExportStartTime;   // seconds from the trigger; empty to export from the first packet
+    std::string mExportEndTime;     // empty to export up to the last packet
+    std::string mExportIdentifiers; // empty to export every identifier
 
     BitState Recessive();
     BitState Dominant();
@@ -30,5 +64,28 @@ class CanAnalyzerSettings : public AnalyzerSettings
     std::auto_ptr<AnalyzerSettingInterfaceChannel> mCanChannelInterface;
     std::auto_ptr<AnalyzerSettingInterfaceInteger> mBitRateInterface;
     std::auto_ptr<AnalyzerSettingInterfaceBool> mCanChannelInvertedInterface;
+    std::auto_ptr<AnalyzerSettingInterfaceNumberList> mCommitPolicyInterface;
+    std::auto_ptr<AnalyzerSettingInterfaceText> mCacheFolderInterface;
+    std::auto_ptr<AnalyzerSettingInterfaceBool> mIsoTpInterface;
+    std::auto_ptr<AnalyzerSettingInterfaceBool> mJ1939Interface;
+    std::auto_ptr<AnalyzerSettingInterfaceText> mDbcPathInterface;
+    std::auto_ptr<AnalyzerSettingInterfaceInteger> mBusLoadWindowInterface;
+    std::auto_ptr<AnalyzerSettingInterfaceNumberList> mCycleTimeInterface;
+    std::auto_ptr<AnalyzerSettingInterfaceBool> mRemoteLatencyInterface;
+    std::auto_ptr<AnalyzerSettingInterfaceChannel> mGatewayChannelInterface;
+    std::auto_ptr<AnalyzerSettingInterfaceInteger> mGlitchFilterInterface;
+    std::auto_ptr<AnalyzerSettingInterfaceInteger> mXlDataBitRateInterface;
+    std::auto_ptr<AnalyzerSettingInterfaceText> mLiveFeedNameInterface;
+    std::auto_ptr<AnalyzerSettingInterfaceText> mReplayLogPathInterface;
+    std::auto_ptr<AnalyzerSettingInterfaceText> mExportStartTimeInterface;
+    std::auto_ptr<AnalyzerSettingInterfaceText> mExportEndTimeInterface;
+    std::auto_ptr<AnalyzerSettingInterfaceText> mExportIdentifiersInterface;
+
+    void UpdateChannels( bool is_used );
 };
+
+bool ParseExportTime( const std::string& text, double& time_s ); // false unless text is a number
+// hex, separated by commas or spaces; sorted, with bit 31 set on the extended ones
+bool ParseExportIdentifiers( const std::string& text, std::vector<U32>& identifiers );
+
 #endif // CAN_ANALYZER_SETTINGS
@@ -0,0 +1,181 @@
+#include "CanColumnarExport.h"
+#include <cstdio>
+#include <limits>
+#include <sstream>
+
+CanColumnarExport::CanColumnarExport( const char* manifest_path, const CanDbc* dbc )
+    : mManifestPath( manifest_path ), mDbc( dbc ), mWriteFailed( false )
+{
+    // column files sit next to the manifest: <manifest name without extension>_<STD|EXT>_<id>_<column>.bin
+    mColumnPrefix = mManifestPath;
+    size_t dot = mColumnPrefix.find_last_of( '.' );
+    size_t slash = mColumnPrefix.find_last_of( "/\\" );
+    if( dot != std::string::npos && ( slash == std::string::npos || dot > slash ) )
+        mColumnPrefix.erase( dot );
+}
+
+void CanColumnarExport::AddMessage( double time_s, const CanMessage& message )
+{
+    IdColumns& id_columns = *FindIdColumns( message );
+    U8 dlc = U8( message.mDlc );
+
+    Append( id_columns.mColumns[ 0 ], &time_s, sizeof( time_s ) );
+    Append( id_columns.mColumns[ 1 ], &dlc, sizeof( dlc ) );
+
+    if( id_columns.mDbcMessage != NULL )
+    {
+        const DbcMessage& dbc_message = *id_columns.mDbcMessage;
+        const DbcSignal* first_signal = &mDbc->GetSignal( dbc_message.mFirstSignal );
+
+        mDbcValues.clear();
+        mDbc->Decode( dbc_message, message, mDbcValues );
+
+        mSignalValues.assign( dbc_message.mNumSignals, std::numeric_limits<double>::quiet_NaN() );
+        for( U32 i = 0; i < mDbcValues.size(); i++ )
+            mSignalValues[ mDbcValues[ i ].mSignal - first_signal ] = mDbcValues[ i ].mValue;
+
+        for( U32 i = 0; i < dbc_message.mNumSignals; i++ )
+            Append( id_columns.mColumns[ 2 + i ], &mSignalValues[ i ], sizeof( double ) );
+    }
+    else
+    {
+        // byte lane columns are created the first time a lane is seen, back-filled with zeros for earlier messages.
+        while( id_columns.mColumns.size() - 2 < message.mNumDataBytes )
+        {
+            std::stringstream name;
+            name << "byte" << id_columns.mColumns.size() - 2;
+            AddColumn( id_columns, name.str(), "<u1", sizeof( U8 ) );
+        }
+
+        U32 num_lanes = id_columns.mColumns.size() - 2;
+        for( U32 i = 0; i < num_lanes; i++ )
+        {
+            U8 value = i < message.mNumDataBytes ? message.mData[ i ] : 0;
+            Append( id_columns.mColumns[ 2 + i ], &value, sizeof( value ) );
+        }
+    }
+
+    id_columns.mCount++;
+}
+
+bool CanColumnarExport::Finish( U32 sample_rate_hz )
+{
+    std::stringstream ss;
+    ss << "{\n  \"format\": \"can-columns\",\n  \"version\": 1,\n  \"sample_rate_hz\": " << sample_rate_hz << ",\n  \"ids\": [";
+
+    for( U32 i = 0; i < mIds.size(); i++ )
+    {
+        IdColumns& id_columns = mIds[ i ];
+
+        ss << ( i == 0 ? "\n" : ",\n" );
+        ss << "    {\n      \"id\": " << id_columns.mIdentifier << ",\n";
+        ss << "      \"extended\": " << ( id_columns.mExtended ? "true" : "false" ) << ",\n";
+        if( id_columns.mDbcMessage != NULL )
+            ss << "      \"message\": \"" << id_columns.mDbcMessage->mName << "\",\n";
+        ss << "      \"count\": " << id_columns.mCount << ",\n";
+        ss << "      \"columns\": [";
+
+        for( U32 j = 0; j < id_columns.mColumns.size(); j++ )
+        {
+            Column& column = id_columns.mColumns[ j ];
+            Flush( column );
+
+            std::string file = column.mPath.substr( column.mPath.find_last_of( "/\\" ) + 1 );
+            ss << ( j == 0 ? "\n" : ",\n" );
+            ss << "        { \"name\": \"" << column.mName << "\", \"dtype\": \"" << column.mDtype << "\", \"file\": \"" << file << "\"";
+            if( column.mSignal != NULL && column.mSignal->mUnit.empty() == false )
+                ss << ", \"unit\": \"" << column.mSignal->mUnit << "\"";
+            ss << " }";
+        }
+        ss << "\n      ]\n    }";
+    }
+    ss << "\n  ]\n}\n";
+
+    FILE* manifest = fopen( mManifestPath.c_str(), "wb" );
+    if( manifest == NULL )
+        return false;
+
+    std::string text = ss.str();
+    bool written = fwrite( text.c_str(), 1, text.length(), manifest ) == text.length();
+    fclose( manifest );
+
+    return written == true && mWriteFailed == false;
+}
+
+CanColumnarExport::IdColumns* CanColumnarExport::FindIdColumns( const CanMessage& message )
+{
+    U32 key = message.mIdentifier | ( message.mExtended ? 0x80000000 : 0 );
+
+    std::unordered_map<U32, U32>::iterator it = mIdIndex.find( key );
+    if( it != mIdIndex.end() )
+        return &mIds[ it->second ];
+
+    mIdIndex[ key ] = mIds.size();
+    mIds.push_back( IdColumns() );
+
+    IdColumns& id_columns = mIds.back();
+    id_columns.mIdentifier = message.mIdentifier;
+    id_columns.mExtended = message.mExtended;
+    id_columns.mDbcMessage = mDbc != NULL ? mDbc->FindMessage( message.mIdentifier, message.mExtended ) : NULL;
+    id_columns.mCount = 0;
+
+    AddColumn( id_columns, "time", "<f8", sizeof( double ) );
+    AddColumn( id_columns, "dlc", "<u1", sizeof( U8 ) );
+
+    if( id_columns.mDbcMessage != NULL )
+    {
+        for( U32 i = 0; i < id_columns.mDbcMessage->mNumSignals; i++ )
+        {
+            const DbcSignal& signal = mDbc->GetSignal( id_columns.mDbcMessage->mFirstSignal + i );
+            AddColumn( id_columns, signal.mName, "<f8", sizeof( double ) );
+            id_columns.mColumns.back().mSignal = &signal;
+        }
+    }
+
+    return &id_columns;
+}
+
+void CanColumnarExport::AddColumn( IdColumns& id_columns, const std::string& name, const char* dtype, U32 element_size )
+{
+    char id_str[ 32 ];
+    snprintf( id_str, sizeof( id_str ), id_columns.mExtended ? "_EXT_%08X_" : "_STD_%03X_", id_columns.mIdentifier );
+
+    id_columns.mColumns.push_back( Column() );
+    Column& column = id_columns.mColumns.back();
+    column.mName = name;
+    column.mPath = mColumnPrefix + id_str + name + ".bin";
+    column.mDtype = dtype;
+    column.mSignal = NULL;
+    column.mCreated = false;
+
+    // a column added after messages were already written starts with zeros for them.
+    column.mBuffer.assign( id_columns.mCount * element_size, 0 );
+}
+
+void CanColumnarExport::Append( Column& column, const void* data, U32 size )
+{
+    const U8* bytes = ( const U8* )data;
+    column.mBuffer.insert( column.mBuffer.end(), bytes, bytes + size );
+
+    if( column.mBuffer.size() >= COLUMN_BUFFER_BYTES )
+        Flush( column );
+}
+
+void CanColumnarExport::Flush( Column& column )
+{
+    // files are opened only to append a full buffer, so the number of identifiers is never limited by open file handles.
+    FILE* f = fopen( column.mPath.c_str(), column.mCreated ? "ab" : "wb" );
+    if( f == NULL )
+    {
+        mWriteFailed = true;
+        column.mBuffer.clear();
+        return;
+    }
+
+    if( column.mBuffer.empty() == false && fwrite( &column.mBuffer[ 0 ], 1, column.mBuffer.size(), f ) != column.mBuffer.size() )
+        mWriteFailed = true;
+
+    fclose( f );
+    column.mCreated = true;
+    column.mBuffer.clear();
+}
@@ -0,0 +1,63 @@
+#ifndef CAN_COLUMNAR_EXPORT
+#define CAN_COLUMNAR_EXPORT
+
+#include "CanMessage.h"
+#include "CanDbc.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// bytes buffered per column file before they are appended to disk.
+#define COLUMN_BUFFER_BYTES 65536
+
+// Writes decoded messages as raw little-endian typed arrays, one file per column, plus a JSON manifest describing them.
+//
+// Every identifier gets a float64 time column (seconds from the trigger) and a uint8 DLC column. When the identifier is
+// defined in the DBC file it also gets one float64 column per signal (NaN where the signal is absent), otherwise one uint8
+// column per byte lane (0 past the end of the data). All columns of an identifier have the same length, so they load
+// straight into NumPy with np.fromfile or into Arrow as fixed-width buffers.
+class CanColumnarExport
+{
+  public:
+    CanColumnarExport( const char* manifest_path, const CanDbc* dbc );
+
+    void AddMessage( double time_s, const CanMessage& message );
+    bool Finish( U32 sample_rate_hz );
+
+  protected:
+    struct Column
+    {
+        std::string mName;
+        std::string mPath;
+        const char* mDtype;
+        const DbcSignal* mSignal; // NULL unless the column holds a DBC signal
+        std::vector<U8> mBuffer;
+        bool mCreated;
+    };
+
+    struct IdColumns
+    {
+        U32 mIdentifier;
+        bool mExtended;
+        const DbcMessage* mDbcMessage;
+        U64 mCount;
+        std::vector<Column> mColumns; // time, dlc, then signals or byte lanes
+    };
+
+    IdColumns* FindIdColumns( const CanMessage& message );
+    void AddColumn( IdColumns& id_columns, const std::string& name, const char* dtype, U32 element_size );
+    void Append( Column& column, const void* data, U32 size );
+    void Flush( Column& column );
+
+    std::string mManifestPath;
+    std::string mColumnPrefix;
+    const CanDbc* mDbc;
+    bool mWriteFailed;
+
+    std::vector<IdColumns> mIds;
+    std::unordered_map<U32, U32> mIdIndex; // identifier (bit 31 set when extended) to index into mIds
+    std::vector<DbcValue> mDbcValues;
+    std::vector<double> mSignalValues;
+};
+
+#endif // CAN_COLUMNAR_EXPORT
@@ -0,0 +1,194 @@
+#include "CanCycleTime.h"
+#include <cstddef>
+
+namespace
+{
+    const U32 gExtendedKeyFlag = 0x80000000;
+
+    U32 HashKey( U32 key )
+    {
+        return key * 2654435761u;
+    }
+}
+
+CanCycleTime::CanCycleTime() : mLookupMask( 0 ), mSampleRateHz( 0 ), mMultiple( 0.0 ), mTickSamples( 1 ), mCurrentTick( 0 )
+{
+}
+
+CanCycleTime::~CanCycleTime()
+{
+}
+
+void CanCycleTime::Reset( U32 sample_rate_hz, double multiple )
+{
+    mSampleRateHz = sample_rate_hz;
+    mMultiple = multiple;
+    mTickSamples = U64( double( sample_rate_hz ) * CYCLE_TIME_TICK_S );
+    if( mTickSamples == 0 )
+        mTickSamples = 1;
+    mCurrentTick = 0;
+
+    mEntries.clear();
+    mEntries.reserve( CYCLE_TIME_MAX_IDS );
+    mLookup.assign( CYCLE_TIME_MAX_IDS * 2, -1 );
+    mLookupMask = CYCLE_TIME_MAX_IDS * 2 - 1;
+    mWheel.assign( CYCLE_TIME_WHEEL_SLOTS, -1 );
+}
+
+void CanCycleTime::AdvanceTo( U64 sample, U32 identifier, bool extended, std::vector<CycleTimeEvent>& events )
+{
+    U32 arriving_key = identifier | ( extended ? gExtendedKeyFlag : 0 );
+    U64 tick = sample / mTickSamples;
+    if( tick < mCurrentTick )
+        return;
+
+    // the current tick is visited again: its deadlines that were still ahead of the previous sample may have passed since.
+    // past a full turn of the wheel every slot is due, so each one needs visiting only once.
+    U64 first_tick = mCurrentTick;
+    if( tick - mCurrentTick >= CYCLE_TIME_WHEEL_SLOTS )
+        first_tick = tick - CYCLE_TIME_WHEEL_SLOTS + 1;
+
+    for( U64 t = first_tick; t <= tick; t++ )
+    {
+        S32 index = mWheel[ t & ( CYCLE_TIME_WHEEL_SLOTS - 1 ) ];
+        while( index >= 0 )
+        {
+            Entry& entry = mEntries[ index ];
+            S32 next = entry.mNext;
+
+            // the slot also holds deadlines from later turns of the wheel.
+            if( entry.mDeadline < sample && entry.mKey != arriving_key )
+            {
+                Disarm( index );
+                entry.mMissingReported = true;
+
+                CycleTimeEvent event;
+                event.mType = CycleTimeMissing;
+                event.mIdentifier = entry.mKey & ~gExtendedKeyFlag;
+                event.mExtended = ( entry.mKey & gExtendedKeyFlag ) != 0;
+                event.mSample = entry.mDeadline;
+                event.mPeriodSamples = U64( entry.mPeriod );
+                event.mIntervalSamples = entry.mDeadline - entry.mLastArrival;
+                events.push_back( event );
+            }
+
+            index = next;
+        }
+    }
+
+    mCurrentTick = tick;
+}
+
+void CanCycleTime::ProcessMessage( const CanMessage& message, std::vector<CycleTimeEvent>& events )
+{
+    Entry* entry = FindEntry( message.mIdentifier | ( message.mExtended ? gExtendedKeyFlag : 0 ) );
+    if( entry == NULL )
+        return;
+
+    U64 arrival = message.mStartingSample;
+    S32 index = S32( entry - &mEntries[ 0 ] );
+
+    if( entry->mLastArrival != 0 && arrival > entry->mLastArrival )
+    {
+        double interval = double( arrival - entry->mLastArrival );
+        bool learned = entry->mIntervals >= CYCLE_TIME_WARMUP_INTERVALS;
+
+        if( learned == true && entry->mMissingReported == false && interval > mMultiple * entry->mPeriod )
+        {
+            CycleTimeEvent event;
+            event.mType = CycleTimeLate;
+            event.mIdentifier = message.mIdentifier;
+            event.mExtended = message.mExtended;
+            event.mSample = arrival;
+            event.mPeriodSamples = U64( entry->mPeriod );
+            event.mIntervalSamples = arrival - entry->mLastArrival;
+            events.push_back( event );
+        }
+
+        // an outage already reported as missing says nothing about the period.
+        if( entry->mMissingReported == false )
+        {
+            if( entry->mIntervals == 0 )
+                entry->mPeriod = interval;
+            else
+                entry->mPeriod += ( interval - entry->mPeriod ) * CYCLE_TIME_EWMA_GAIN;
+            entry->mIntervals++;
+        }
+    }
+
+    entry->mLastArrival = arrival;
+    entry->mMissingReported = false;
+
+    if( entry->mIntervals >= CYCLE_TIME_WARMUP_INTERVALS )
+        Arm( index, arrival + U64( mMultiple * entry->mPeriod ) );
+}
+
+CanCycleTime::Entry* CanCycleTime::FindEntry( U32 key )
+{
+    U32 slot = HashKey( key ) & mLookupMask;
+    for( ;; )
+    {
+        S32 index = mLookup[ slot ];
+        if( index < 0 )
+            break;
+        if( mEntries[ index ].mKey == key )
+            return &mEntries[ index ];
+        slot = ( slot + 1 ) & mLookupMask;
+    }
+
+    if( mEntries.size() >= CYCLE_TIME_MAX_IDS )
+        return NULL;
+
+    Entry entry;
+    entry.mKey = key;
+    entry.mLastArrival = 0;
+    entry.mPeriod = 0.0;
+    entry.mIntervals = 0;
+    entry.mMissingReported = false;
+    entry.mDeadline = 0;
+    entry.mSlot = -1;
+    entry.mPrevious = -1;
+    entry.mNext = -1;
+
+    mLookup[ slot ] = mEntries.size();
+    mEntries.push_back( entry );
+    return &mEntries.back();
+}
+
+void CanCycleTime::Arm( S32 index, U64 deadline )
+{
+    Disarm( index );
+
+    // a deadline that falls in a tick the wheel has already passed goes in the current tick, which is visited again.
+    U64 tick = deadline / mTickSamples;
+    if( tick < mCurrentTick )
+        tick = mCurrentTick;
+
+    Entry& entry = mEntries[ index ];
+    entry.mSlot = S32( tick & ( CYCLE_TIME_WHEEL_SLOTS - 1 ) );
+    S32& head = mWheel[ entry.mSlot ];
+
+    entry.mDeadline = deadline;
+    entry.mPrevious = -1;
+    entry.mNext = head;
+    if( head >= 0 )
+        mEntries[ head ].mPrevious = index;
+    head = index;
+}
+
+void CanCycleTime::Disarm( S32 index )
+{
+    Entry& entry = mEntries[ index ];
+    if( entry.mSlot < 0 )
+        return;
+
+    if( entry.mPrevious >= 0 )
+        mEntries[ entry.mPrevious ].mNext = entry.mNext;
+    else
+        mWheel[ entry.mSlot ] = entry.mNext;
+
+    if( entry.mNext >= 0 )
+        mEntries[ entry.mNext ].mPrevious = entry.mPrevious;
+
+    entry.mSlot = -1;
+}
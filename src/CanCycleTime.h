@@ -0,0 +1,77 @@
+#ifndef CAN_CYCLE_TIME
+#define CAN_CYCLE_TIME
+
+#include "CanMessage.h"
+#include <vector>
+
+#define CYCLE_TIME_MAX_IDS 4096      // identifiers tracked; further identifiers are ignored
+#define CYCLE_TIME_WHEEL_SLOTS 1024  // timer wheel size, must be a power of two
+#define CYCLE_TIME_TICK_S 0.001      // timer wheel resolution
+#define CYCLE_TIME_WARMUP_INTERVALS 4 // intervals learned before an identifier is checked
+#define CYCLE_TIME_EWMA_GAIN 0.125
+
+enum CycleTimeEventType
+{
+    CycleTimeLate,
+    CycleTimeMissing
+};
+
+struct CycleTimeEvent
+{
+    CycleTimeEventType mType;
+    U32 mIdentifier;
+    bool mExtended;
+    U64 mSample;          // arrival of the late frame, or the deadline a missing frame did not meet
+    U64 mPeriodSamples;   // learned period
+    U64 mIntervalSamples; // time since the previous frame with this identifier
+};
+
+// Learns the cycle time of every periodic identifier and reports frames that are late or missing.
+//
+// Each identifier's period is an exponentially weighted average of its inter-arrival times. Once learned, every arrival
+// arms a deadline at a multiple of the period on a hashed timer wheel; arrivals that come after their deadline are reported
+// as late, and deadlines that expire with no arrival are reported as missing. Re-arming a deadline and expiring a wheel
+// slot are both constant time, so the work per frame doesn't depend on the number of identifiers.
+class CanCycleTime
+{
+  public:
+    CanCycleTime();
+    ~CanCycleTime();
+
+    void Reset( U32 sample_rate_hz, double multiple );
+
+    // reports deadlines that expired before sample; call before adding anything that starts at sample. the identifier of the
+    // frame starting there is left for ProcessMessage to judge, so a late frame is reported as late rather than missing.
+    void AdvanceTo( U64 sample, U32 identifier, bool extended, std::vector<CycleTimeEvent>& events );
+    void ProcessMessage( const CanMessage& message, std::vector<CycleTimeEvent>& events );
+
+  protected:
+    struct Entry
+    {
+        U32 mKey;
+        U64 mLastArrival;
+        double mPeriod;
+        U32 mIntervals;
+        bool mMissingReported;
+        U64 mDeadline;
+        S32 mSlot; // timer wheel slot while armed, -1 otherwise
+        S32 mPrevious; // slot list links, -1 at either end
+        S32 mNext;
+    };
+
+    Entry* FindEntry( U32 key );
+    void Arm( S32 index, U64 deadline );
+    void Disarm( S32 index );
+
+    std::vector<Entry> mEntries;
+    std::vector<S32> mLookup; // entry index per slot, -1 when empty
+    U32 mLookupMask;
+    std::vector<S32> mWheel; // first armed entry per slot, -1 when empty
+
+    U32 mSampleRateHz;
+    double mMultiple;
+    U64 mTickSamples;
+    U64 mCurrentTick;
+};
+
+#endif // CAN_CYCLE_TIME
@@ -0,0 +1,271 @@
+#include "CanDbc.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+    const U32 gDbcExtendedFlag = 0x80000000;
+    const U32 gExtendedKeyFlag = 0x80000000;
+
+    U32 MessageKey( U32 identifier, bool extended )
+    {
+        return identifier | ( extended ? gExtendedKeyFlag : 0 );
+    }
+
+    U32 HashKey( U32 key )
+    {
+        return key * 2654435761u;
+    }
+
+    const char* SkipSpaces( const char* p )
+    {
+        while( *p == ' ' || *p == '\t' )
+            p++;
+        return p;
+    }
+
+    // copies the next whitespace/punctuation delimited token; returns the position after it.
+    const char* ReadToken( const char* p, std::string& token, const char* delimiters = " \t:" )
+    {
+        p = SkipSpaces( p );
+        const char* end = p;
+        while( *end != 0 && strchr( delimiters, *end ) == NULL )
+            end++;
+        token.assign( p, end );
+        return end;
+    }
+}
+
+CanDbc::CanDbc() : mLookupMask( 0 )
+{
+}
+
+CanDbc::~CanDbc()
+{
+}
+
+bool CanDbc::Load( const std::string& path )
+{
+    Clear();
+
+    std::ifstream file( path.c_str() );
+    if( file.is_open() == false )
+        return false;
+
+    std::string line;
+    std::string token;
+    DbcMessage* message = NULL;
+
+    while( std::getline( file, line ) )
+    {
+        const char* p = SkipSpaces( line.c_str() );
+
+        if( strncmp( p, "BO_ ", 4 ) == 0 )
+        {
+            // BO_ <id> <name>: <dlc> <transmitter>
+            p = ReadToken( p + 4, token );
+            U32 raw_id = strtoul( token.c_str(), NULL, 10 );
+            ReadToken( p, token );
+
+            message = NULL;
+            if( raw_id == 0xC0000000 ) // VECTOR__INDEPENDENT_SIG_MSG holds unassigned signals
+                continue;
+
+            DbcMessage new_message;
+            new_message.mExtended = ( raw_id & gDbcExtendedFlag ) != 0;
+            new_message.mIdentifier = raw_id & 0x1FFFFFFF;
+            new_message.mName = token;
+            new_message.mFirstSignal = mSignals.size();
+            new_message.mNumSignals = 0;
+            new_message.mMultiplexor = DBC_NO_MULTIPLEXOR;
+            mMessages.push_back( new_message );
+            message = &mMessages.back();
+        }
+        else if( strncmp( p, "SG_ ", 4 ) == 0 && message != NULL )
+        {
+            DbcSignal signal;
+            if( ParseSignal( p + 4, signal ) == false )
+                continue;
+
+            if( signal.mIsMultiplexor == true )
+                message->mMultiplexor = message->mNumSignals;
+
+            mSignals.push_back( signal );
+            message->mNumSignals++;
+        }
+        else if( *p != 0 )
+        {
+            message = NULL;
+        }
+    }
+
+    BuildLookupTable();
+    return true;
+}
+
+void CanDbc::Clear()
+{
+    mMessages.clear();
+    mSignals.clear();
+    mLookup.clear();
+    mLookupMask = 0;
+}
+
+bool CanDbc::IsLoaded() const
+{
+    return mMessages.empty() == false;
+}
+
+const DbcMessage* CanDbc::FindMessage( U32 identifier, bool extended ) const
+{
+    if( mLookup.empty() == true )
+        return NULL;
+
+    U32 key = MessageKey( identifier, extended );
+    for( U32 slot = HashKey( key ) & mLookupMask;; slot = ( slot + 1 ) & mLookupMask )
+    {
+        S32 index = mLookup[ slot ];
+        if( index < 0 )
+            return NULL;
+
+        const DbcMessage& message = mMessages[ index ];
+        if( MessageKey( message.mIdentifier, message.mExtended ) == key )
+            return &message;
+    }
+}
+
+const DbcSignal& CanDbc::GetSignal( U32 index ) const
+{
+    return mSignals[ index ];
+}
+
+void CanDbc::Decode( const DbcMessage& dbc_message, const CanMessage& message, std::vector<DbcValue>& values ) const
+{
+    U64 little_endian = 0;
+    U64 big_endian = 0;
+    for( U32 i = 0; i < message.mNumDataBytes && i < 8; i++ )
+    {
+        little_endian |= U64( message.mData[ i ] ) << ( 8 * i );
+        big_endian |= U64( message.mData[ i ] ) << ( 56 - 8 * i );
+    }
+
+    S64 multiplex_value = DBC_NO_MULTIPLEXOR;
+    const DbcSignal* signals = &mSignals[ dbc_message.mFirstSignal ];
+
+    if( dbc_message.mMultiplexor != DBC_NO_MULTIPLEXOR )
+    {
+        const DbcSignal& mux = signals[ dbc_message.mMultiplexor ];
+        if( mux.mMinBytes <= message.mNumDataBytes )
+            multiplex_value = S64( ( ( mux.mLittleEndian ? little_endian : big_endian ) >> mux.mShift ) & mux.mMask );
+    }
+
+    for( U32 i = 0; i < dbc_message.mNumSignals; i++ )
+    {
+        const DbcSignal& signal = signals[ i ];
+
+        if( signal.mMinBytes > message.mNumDataBytes )
+            continue;
+        if( signal.mMultiplexValue != DBC_NO_MULTIPLEXOR && signal.mMultiplexValue != multiplex_value )
+            continue;
+
+        U64 raw = ( ( signal.mLittleEndian ? little_endian : big_endian ) >> signal.mShift ) & signal.mMask;
+
+        DbcValue value;
+        value.mSignal = &signal;
+        if( signal.mSigned == true && ( raw & ~( signal.mMask >> 1 ) ) != 0 )
+            value.mValue = double( S64( raw | ~signal.mMask ) ) * signal.mScale + signal.mOffset;
+        else
+            value.mValue = double( raw ) * signal.mScale + signal.mOffset;
+        values.push_back( value );
+    }
+}
+
+bool CanDbc::ParseSignal( const char* line, DbcSignal& signal )
+{
+    // <name> [M|m<n>] : <start>|<length>@<0|1><+|-> (<scale>,<offset>) [<min>|<max>] "<unit>" <receivers>
+    std::string token;
+    const char* p = ReadToken( line, signal.mName );
+
+    signal.mIsMultiplexor = false;
+    signal.mMultiplexValue = DBC_NO_MULTIPLEXOR;
+
+    p = SkipSpaces( p );
+    if( *p != ':' )
+    {
+        p = ReadToken( p, token );
+        if( token == "M" )
+            signal.mIsMultiplexor = true;
+        else if( token.size() > 1 && token[ 0 ] == 'm' )
+            signal.mMultiplexValue = atoi( token.c_str() + 1 ); // "m3M" (nested multiplexing) is treated as "m3"
+        p = SkipSpaces( p );
+    }
+
+    U32 start_bit;
+    U32 length;
+    char byte_order;
+    char sign;
+    int consumed = 0;
+    if( *p != ':' || sscanf( p + 1, " %u|%u@%c%c (%lf,%lf)%n", &start_bit, &length, &byte_order, &sign, &signal.mScale, &signal.mOffset,
+                             &consumed ) != 6 )
+        return false;
+
+    if( length == 0 || length > 64 )
+        return false;
+
+    p = strchr( p + 1 + consumed, '"' );
+    if( p != NULL )
+    {
+        const char* end = strchr( p + 1, '"' );
+        if( end != NULL )
+            signal.mUnit.assign( p + 1, end );
+    }
+
+    signal.mLittleEndian = byte_order == '1';
+    signal.mSigned = sign == '-';
+    signal.mMask = length == 64 ? ~0ull : ( ( 1ull << length ) - 1 );
+
+    U32 last_bit; // highest payload bit position (in transmit order) the signal touches
+    if( signal.mLittleEndian == true )
+    {
+        // Intel: start_bit is the LSB, counting up through the little-endian word.
+        if( start_bit + length > 64 )
+            return false;
+        signal.mShift = start_bit;
+        last_bit = start_bit + length - 1;
+        signal.mMinBytes = last_bit / 8 + 1;
+    }
+    else
+    {
+        // Motorola: start_bit is the MSB in DBC's sawtooth numbering; convert to a position in the big-endian word.
+        U32 msb = ( start_bit / 8 ) * 8 + ( 7 - start_bit % 8 );
+        U32 lsb = msb + length - 1;
+        if( lsb > 63 )
+            return false;
+        signal.mShift = 63 - lsb;
+        signal.mMinBytes = lsb / 8 + 1;
+    }
+
+    return true;
+}
+
+void CanDbc::BuildLookupTable()
+{
+    U32 size = 16;
+    while( size < mMessages.size() * 2 )
+        size <<= 1;
+
+    mLookup.assign( size, -1 );
+    mLookupMask = size - 1;
+
+    U32 count = mMessages.size();
+    for( U32 i = 0; i < count; i++ )
+    {
+        U32 key = MessageKey( mMessages[ i ].mIdentifier, mMessages[ i ].mExtended );
+        U32 slot = HashKey( key ) & mLookupMask;
+        while( mLookup[ slot ] >= 0 )
+            slot = ( slot + 1 ) & mLookupMask;
+        mLookup[ slot ] = i;
+    }
+}
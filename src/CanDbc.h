@@ -0,0 +1,72 @@
+#ifndef CAN_DBC
+#define CAN_DBC
+
+#include "CanMessage.h"
+#include <string>
+#include <vector>
+
+#define DBC_NO_MULTIPLEXOR -1
+
+struct DbcSignal
+{
+    std::string mName;
+    std::string mUnit;
+
+    // extraction plan: load the payload as one 64-bit word in the signal's byte order, then shift and mask.
+    bool mLittleEndian;
+    bool mSigned;
+    U32 mShift;
+    U64 mMask;
+    U32 mMinBytes; // payload bytes needed to hold the signal
+    double mScale;
+    double mOffset;
+
+    bool mIsMultiplexor;
+    S32 mMultiplexValue; // DBC_NO_MULTIPLEXOR unless this signal is only present for one multiplexor value
+};
+
+struct DbcMessage
+{
+    U32 mIdentifier;
+    bool mExtended;
+    std::string mName;
+    U32 mFirstSignal;
+    U32 mNumSignals;
+    S32 mMultiplexor; // index into the signal list, or DBC_NO_MULTIPLEXOR
+};
+
+struct DbcValue
+{
+    const DbcSignal* mSignal;
+    double mValue;
+};
+
+// Signal definitions from a DBC file, compiled into per-message extraction plans.
+//
+// The file is parsed once; messages are then found through a flat open-addressed table keyed by identifier, and each
+// signal is extracted with a load, shift and mask, so decoding a frame involves no string handling at all.
+class CanDbc
+{
+  public:
+    CanDbc();
+    ~CanDbc();
+
+    bool Load( const std::string& path );
+    void Clear();
+    bool IsLoaded() const;
+
+    const DbcMessage* FindMessage( U32 identifier, bool extended ) const;
+    const DbcSignal& GetSignal( U32 index ) const;
+    void Decode( const DbcMessage& dbc_message, const CanMessage& message, std::vector<DbcValue>& values ) const;
+
+  protected:
+    bool ParseSignal( const char* line, DbcSignal& signal );
+    void BuildLookupTable();
+
+    std::vector<DbcMessage> mMessages;
+    std::vector<DbcSignal> mSignals;
+    std::vector<S32> mLookup; // message index per slot, -1 when empty
+    U32 mLookupMask;
+};
+
+#endif // CAN_DBC
@@ -0,0 +1,478 @@
+// can_decode: decodes recorded CAN captures without the Logic software, with the analyzer's CanFrameDecoder.
+//
+//     can_decode --sample-rate 10000000 --bit-rate 500000 capture1.bin capture2.bin ...
+//
+// Each input file is memory mapped, decoded, and written next to it (or to --output-dir) as CSV or binary frames. Files are
+// decoded in parallel, one per thread.
+
+#include "CanFrameDecoder.h"
+#include "CanSampleBuffer.h"
+#include "CanEdgeBuffer.h"
+#include "CanLiveFeedFormat.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// after the last edge of an edges file, the bus stays idle for this long, so the last frame can end.
+#define EDGE_FILE_IDLE_BITS 16
+
+#define OUTPUT_BUFFER_BYTES ( 1 << 20 )
+
+namespace
+{
+    enum InputFormat
+    {
+        PackedSamples, // one bit per sample, least significant bit first
+        EdgeSamples    // the sample number of each edge, as little endian 64-bit integers
+    };
+
+    enum OutputFormat
+    {
+        CsvOutput,
+        BinaryOutput // a CanLiveFeedFrame for each complete data or remote frame
+    };
+
+    struct Options
+    {
+        CanDecoderConfig mConfig;
+        InputFormat mInputFormat;
+        OutputFormat mOutputFormat;
+        BitState mInitialState; // of an edges file
+        std::string mOutputFolder;
+        U32 mNumJobs;
+    };
+
+    // a read-only mapping of a whole file.
+    class MappedFile
+    {
+      public:
+        MappedFile() : mData( NULL ), mSize( 0 )
+        {
+        }
+
+        ~MappedFile()
+        {
+            if( mData != NULL )
+                munmap( ( void* )mData, size_t( mSize ) );
+        }
+
+        bool Open( const std::string& path )
+        {
+            int fd = open( path.c_str(), O_RDONLY );
+            if( fd < 0 )
+                return false;
+
+            struct stat info;
+            if( fstat( fd, &info ) != 0 || info.st_size == 0 )
+            {
+                close( fd );
+                return false;
+            }
+
+            void* mapping = mmap( NULL, size_t( info.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+            close( fd );
+            if( mapping == MAP_FAILED )
+                return false;
+
+            madvise( mapping, size_t( info.st_size ), MADV_SEQUENTIAL ); // the decoder only reads forwards
+            mData = ( const U8* )mapping;
+            mSize = U64( info.st_size );
+            return true;
+        }
+
+        const U8* mData;
+        U64 mSize;
+    };
+
+    // writes what each DecodeFrame call found.
+    class FrameWriter
+    {
+      public:
+        FrameWriter( FILE* file, OutputFormat format, U32 sample_rate_hz )
+            : mFile( file ), mFormat( format ), mSampleRateHz( sample_rate_hz ), mNumPackets( 0 )
+        {
+            if( mFormat == CsvOutput )
+                fprintf( mFile, "Time [s],Packet,Type,Identifier,Control,Data,CRC,ACK\n" );
+        }
+
+        void Write( const CanFrameDecoder& decoder )
+        {
+            if( mFormat == BinaryOutput )
+            {
+                WriteBinary( decoder );
+                return;
+            }
+
+            if( decoder.IsFrameComplete() == true )
+                WriteCsvFrame( decoder );
+            if( decoder.IsError() == true )
+                WriteCsvError( decoder );
+        }
+
+      protected:
+        void WriteBinary( const CanFrameDecoder& decoder )
+        {
+            CanMessage message;
+            if( decoder.GetMessage( message ) == false )
+                return;
+
+            CanLiveFeedFrame frame;
+            memset( &frame, 0, sizeof( frame ) );
+            frame.mStartingSample = message.mStartingSample;
+            frame.mEndingSample = message.mEndingSample;
+            frame.mIdentifier = message.mIdentifier;
+            frame.mDlc = U16( message.mDlc );
+            frame.mFlags = ( message.mExtended ? CAN_LIVE_FEED_EXTENDED : 0 ) | ( message.mRemoteFrame ? CAN_LIVE_FEED_REMOTE : 0 );
+            frame.mNumDataBytes = U8( message.mNumDataBytes );
+            memcpy( frame.mData, message.mData, message.mNumDataBytes );
+            fwrite( &frame, sizeof( frame ), 1, mFile );
+        }
+
+        // the same columns as the analyzer's "Export as text/csv file", in hexadecimal.
+        void WriteCsvFrame( const CanFrameDecoder& decoder )
+        {
+            const std::vector<Frame>& fields = decoder.GetFields();
+            std::string control;
+            std::string data;
+            std::string crc;
+            std::string ack;
+            char number_str[ 32 ];
+
+            U32 count = fields.size();
+            for( U32 i = 0; i < count; i++ )
+            {
+                const Frame& field = fields[ i ];
+                switch( field.mType )
+                {
+                case IdentifierField:
+                case IdentifierFieldEx:
+                    WriteTime( field.mStartingSampleInclusive );
+                    fprintf( mFile, ",%llu,%s,0x%llX", mNumPackets, ( field.mFlags & REMOTE_FRAME ) != 0 ? "REMOTE" : "DATA", field.mData1 );
+                    break;
+                case ControlField:
+                    snprintf( number_str, sizeof( number_str ), "0x%llX", field.mData1 );
+                    control = number_str;
+                    break;
+                case XlControlField:
+                    snprintf( number_str, sizeof( number_str ), "0x%X", CAN_XL_DLC( field.mData1 ) + 1 );
+                    control = number_str;
+                    break;
+                case DataField:
+                    snprintf( number_str, sizeof( number_str ), data.empty() ? "0x%llX" : " 0x%llX", field.mData1 );
+                    data += number_str;
+                    break;
+                case CrcField:
+                case XlFcrcField:
+                    snprintf( number_str, sizeof( number_str ), "0x%llX", field.mData1 );
+                    crc = number_str;
+                    break;
+                case AckField:
+                    ack = field.mData1 != 0 ? "ACK" : "NAK";
+                    break;
+                }
+            }
+
+            fprintf( mFile, ",%s,%s,%s,%s\n", control.c_str(), data.c_str(), crc.c_str(), ack.c_str() );
+            mNumPackets++;
+        }
+
+        // an error gets a row of its own, with the error in the Data column.
+        void WriteCsvError( const CanFrameDecoder& decoder )
+        {
+            WriteTime( decoder.GetErrorStartingSample() );
+            fprintf( mFile, ",,ERROR,,,%s error at bit %u,,\n", CanErrorTypeName( decoder.GetErrorType() ), decoder.GetErrorBit() );
+        }
+
+        void WriteTime( U64 sample )
+        {
+            fprintf( mFile, "%llu.%09llu", sample / mSampleRateHz, ( sample % mSampleRateHz ) * 1000000000ull / mSampleRateHz );
+        }
+
+        FILE* mFile;
+        OutputFormat mFormat;
+        U32 mSampleRateHz;
+        U64 mNumPackets;
+    };
+
+    std::string GetOutputPath( const std::string& input_path, const Options& options )
+    {
+        std::string path = input_path;
+        if( options.mOutputFolder.empty() == false )
+        {
+            size_t slash = input_path.find_last_of( '/' );
+            path = options.mOutputFolder + "/" + ( slash == std::string::npos ? input_path : input_path.substr( slash + 1 ) );
+        }
+
+        return path + ( options.mOutputFormat == CsvOutput ? ".csv" : ".frames" );
+    }
+
+    bool DecodeFile( const std::string& path, const Options& options, std::string& error )
+    {
+        MappedFile input;
+        if( input.Open( path ) == false )
+        {
+            error = "can't map the file";
+            return false;
+        }
+
+        CanSampleBuffer samples;
+        CanEdgeBuffer edges;
+        CanOfflineChannel* channel;
+        if( options.mInputFormat == PackedSamples )
+        {
+            samples.SetSamples( input.mData, input.mSize * 8 );
+            channel = &samples;
+        }
+        else
+        {
+            if( input.mSize % sizeof( U64 ) != 0 )
+            {
+                error = "an edges file is a whole number of 64-bit sample numbers";
+                return false;
+            }
+
+            const U64* edge_samples = ( const U64* )input.mData;
+            U64 num_edges = input.mSize / sizeof( U64 );
+            U64 idle_samples = U64( options.mConfig.mSampleRateHz ) * EDGE_FILE_IDLE_BITS / options.mConfig.mBitRate;
+            edges.SetEdges( edge_samples, num_edges, options.mInitialState, edge_samples[ num_edges - 1 ] + idle_samples );
+            channel = &edges;
+        }
+
+        std::string output_path = GetOutputPath( path, options );
+        FILE* output = fopen( output_path.c_str(), options.mOutputFormat == CsvOutput ? "w" : "wb" );
+        if( output == NULL )
+        {
+            error = "can't create " + output_path;
+            return false;
+        }
+        std::vector<char> output_buffer( OUTPUT_BUFFER_BYTES );
+        setvbuf( output, &output_buffer[ 0 ], _IOFBF, output_buffer.size() );
+
+        FrameWriter writer( output, options.mOutputFormat, options.mConfig.mSampleRateHz );
+        CanFrameDecoder decoder;
+        decoder.Init( channel, options.mConfig );
+
+        // the same loop as the analyzer's worker thread; a frame cut short by the end of the file is dropped.
+        try
+        {
+            decoder.WaitFor7RecessiveBits();
+            for( ;; )
+            {
+                decoder.AdvanceToStartOfFrame();
+                decoder.DecodeFrame();
+                writer.Write( decoder );
+
+                if( decoder.SawErrorFlag() == true )
+                    decoder.WaitFor7RecessiveBits();
+            }
+        }
+        catch( CanEndOfSamples& )
+        {
+        }
+
+        bool written = ferror( output ) == 0;
+        if( fclose( output ) != 0 || written == false )
+        {
+            error = "can't write " + output_path;
+            return false;
+        }
+        return true;
+    }
+
+    void PrintUsage()
+    {
+        fprintf( stderr, "usage: can_decode --sample-rate HZ [options] FILE...\n"
+                         "\n"
+                         "  --sample-rate HZ           sample rate of the captures\n"
+                         "  --bit-rate BPS             bit rate (default 1000000)\n"
+                         "  --xl-data-bit-rate BPS     decode CAN XL frames with this data bit rate (default 0, off)\n"
+                         "  --inverted                 the captures are of CAN High\n"
+                         "  --glitch-filter NS         ignore pulses shorter than this (default 0, off)\n"
+                         "  --input packed|edges       packed: one bit per sample, least significant bit first (default)\n"
+                         "                             edges: the sample number of each edge, as little endian 64-bit integers\n"
+                         "  --initial-level high|low   the level before the first edge of an edges file (default recessive)\n"
+                         "  --output csv|binary        csv: one row per frame or error (default)\n"
+                         "                             binary: a CanLiveFeedFrame record per data or remote frame\n"
+                         "  --output-dir DIR           write the outputs here instead of next to each input\n"
+                         "  --jobs N                   files decoded at once (default: one per core)\n" );
+    }
+
+    // the same checks CanAnalyzerSettings makes.
+    const char* CheckOptions( const Options& options )
+    {
+        const CanDecoderConfig& config = options.mConfig;
+        if( config.mSampleRateHz == 0 )
+            return "--sample-rate is required";
+        if( config.mBitRate < 10000 || config.mBitRate > 25000000 )
+            return "the bit rate must be between 10000 and 25000000";
+        if( config.mXlDataBitRate != 0 && config.mXlDataBitRate < config.mBitRate )
+            return "the CAN XL data bit rate can't be lower than the bit rate";
+
+        U32 fastest_bit_rate = config.mXlDataBitRate > config.mBitRate ? config.mXlDataBitRate : config.mBitRate;
+        if( config.mSampleRateHz < 2 * fastest_bit_rate )
+            return "the sample rate must be at least twice the bit rate";
+        if( double( config.mGlitchFilterNs ) * 1e-9 >= 0.5 / double( fastest_bit_rate ) )
+            return "the glitch filter must be shorter than half a bit time";
+        return NULL;
+    }
+}
+
+int main( int argc, char** argv )
+{
+    enum
+    {
+        SampleRateOption = 256,
+        BitRateOption,
+        XlDataBitRateOption,
+        InvertedOption,
+        GlitchFilterOption,
+        InputOption,
+        InitialLevelOption,
+        OutputOption,
+        OutputFolderOption,
+        JobsOption
+    };
+
+    const struct option long_options[] = { { "sample-rate", required_argument, NULL, SampleRateOption },
+                                           { "bit-rate", required_argument, NULL, BitRateOption },
+                                           { "xl-data-bit-rate", required_argument, NULL, XlDataBitRateOption },
+                                           { "inverted", no_argument, NULL, InvertedOption },
+                                           { "glitch-filter", required_argument, NULL, GlitchFilterOption },
+                                           { "input", required_argument, NULL, InputOption },
+                                           { "initial-level", required_argument, NULL, InitialLevelOption },
+                                           { "output", required_argument, NULL, OutputOption },
+                                           { "output-dir", required_argument, NULL, OutputFolderOption },
+                                           { "jobs", required_argument, NULL, JobsOption },
+                                           { NULL, 0, NULL, 0 } };
+
+    Options options;
+    options.mConfig.mSampleRateHz = 0;
+    options.mConfig.mBitRate = 1000000;
+    options.mConfig.mInverted = false;
+    options.mConfig.mGlitchFilterNs = 0;
+    options.mConfig.mXlDataBitRate = 0;
+    options.mInputFormat = PackedSamples;
+    options.mOutputFormat = CsvOutput;
+    options.mNumJobs = std::thread::hardware_concurrency();
+    const char* initial_level = NULL;
+
+    for( ;; )
+    {
+        int option = getopt_long( argc, argv, "", long_options, NULL );
+        if( option == -1 )
+            break;
+
+        switch( option )
+        {
+        case SampleRateOption:
+            options.mConfig.mSampleRateHz = U32( strtoul( optarg, NULL, 10 ) );
+            break;
+        case BitRateOption:
+            options.mConfig.mBitRate = U32( strtoul( optarg, NULL, 10 ) );
+            break;
+        case XlDataBitRateOption:
+            options.mConfig.mXlDataBitRate = U32( strtoul( optarg, NULL, 10 ) );
+            break;
+        case InvertedOption:
+            options.mConfig.mInverted = true;
+            break;
+        case GlitchFilterOption:
+            options.mConfig.mGlitchFilterNs = U32( strtoul( optarg, NULL, 10 ) );
+            break;
+        case InputOption:
+            if( strcmp( optarg, "packed" ) != 0 && strcmp( optarg, "edges" ) != 0 )
+            {
+                PrintUsage();
+                return 2;
+            }
+            options.mInputFormat = strcmp( optarg, "packed" ) == 0 ? PackedSamples : EdgeSamples;
+            break;
+        case InitialLevelOption:
+            if( strcmp( optarg, "high" ) != 0 && strcmp( optarg, "low" ) != 0 )
+            {
+                PrintUsage();
+                return 2;
+            }
+            initial_level = optarg;
+            break;
+        case OutputOption:
+            if( strcmp( optarg, "csv" ) != 0 && strcmp( optarg, "binary" ) != 0 )
+            {
+                PrintUsage();
+                return 2;
+            }
+            options.mOutputFormat = strcmp( optarg, "csv" ) == 0 ? CsvOutput : BinaryOutput;
+            break;
+        case OutputFolderOption:
+            options.mOutputFolder = optarg;
+            break;
+        case JobsOption:
+            options.mNumJobs = U32( strtoul( optarg, NULL, 10 ) );
+            break;
+        default:
+            PrintUsage();
+            return 2;
+        }
+    }
+
+    if( optind >= argc )
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    const char* problem = CheckOptions( options );
+    if( problem != NULL )
+    {
+        fprintf( stderr, "can_decode: %s\n", problem );
+        return 2;
+    }
+
+    // the bus idles recessive.
+    if( initial_level != NULL )
+        options.mInitialState = strcmp( initial_level, "high" ) == 0 ? BIT_HIGH : BIT_LOW;
+    else
+        options.mInitialState = options.mConfig.mInverted ? BIT_LOW : BIT_HIGH;
+
+    std::vector<std::string> paths( argv + optind, argv + argc );
+    U32 num_jobs = options.mNumJobs == 0 ? 1 : options.mNumJobs;
+    if( num_jobs > paths.size() )
+        num_jobs = U32( paths.size() );
+
+    // each thread takes the next file until there are none left.
+    std::atomic<U32> next_path( 0 );
+    std::atomic<U32> num_failures( 0 );
+    std::vector<std::thread> jobs;
+    for( U32 i = 0; i < num_jobs; i++ )
+    {
+        jobs.push_back( std::thread( [&]() {
+            for( ;; )
+            {
+                U32 index = next_path++;
+                if( index >= paths.size() )
+                    return;
+
+                std::string error;
+                if( DecodeFile( paths[ index ], options, error ) == false )
+                {
+                    fprintf( stderr, "can_decode: %s: %s\n", paths[ index ].c_str(), error.c_str() );
+                    num_failures++;
+                }
+            }
+        } ) );
+    }
+
+    for( U32 i = 0; i < num_jobs; i++ )
+        jobs[ i ].join();
+
+    return num_failures == 0 ? 0 : 1;
+}
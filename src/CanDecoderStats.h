@@ -0,0 +1,71 @@
+#ifndef CAN_DECODER_STATS_H
+#define CAN_DECODER_STATS_H
+
+#include <AnalyzerTypes.h>
+
+// Decoder performance counters. These are compiled out unless the analyzer is built with CAN_DECODER_STATS defined
+// (cmake -DCAN_DECODER_STATS=ON); wrap every use in CAN_STATS() so the release build carries no counting overhead.
+
+#ifdef CAN_DECODER_STATS
+
+#include <chrono>
+
+#define CAN_STATS( statement ) statement
+
+// emit a "decoder_stats" FrameV2 every time this many frames (or errors) have been decoded.
+#define DECODER_STATS_FRAME_INTERVAL 1000
+
+struct CanDecoderStats
+{
+    CanDecoderStats()
+        : mEdgesConsumed( 0 ),
+          mChannelSeeks( 0 ),
+          mFrames( 0 ),
+          mStuffBits( 0 ),
+          mErrors( 0 ),
+          mResyncs( 0 ),
+          mGlitches( 0 ),
+          mSamplingNs( 0 ),
+          mEmissionNs( 0 ),
+          mLastReportedFrames( 0 )
+    {
+    }
+
+    U64 mEdgesConsumed;
+    U64 mChannelSeeks;
+    U64 mFrames;
+    U64 mStuffBits;
+    U64 mErrors;
+    U64 mResyncs;
+    U64 mGlitches; // pulses dropped by the glitch filter
+    U64 mSamplingNs; // walking edges and sampling raw bits
+    U64 mEmissionNs; // destuffing, field decode and adding results
+
+    U64 mLastReportedFrames;
+};
+
+// adds the lifetime of the timer to the given nanosecond accumulator.
+class CanStatsTimer
+{
+  public:
+    CanStatsTimer( U64& accumulator ) : mAccumulator( accumulator ), mStart( std::chrono::steady_clock::now() )
+    {
+    }
+
+    ~CanStatsTimer()
+    {
+        mAccumulator += std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - mStart ).count();
+    }
+
+  protected:
+    U64& mAccumulator;
+    std::chrono::steady_clock::time_point mStart;
+};
+
+#else
+
+#define CAN_STATS( statement )
+
+#endif // CAN_DECODER_STATS
+
+#endif // CAN_DECODER_STATS_H
@@ -0,0 +1,71 @@
+#include "CanEdgeBuffer.h"
+#include <cstddef>
+
+CanEdgeBuffer::CanEdgeBuffer()
+    : mEdges( NULL ), mNumEdges( 0 ), mNumSamples( 0 ), mNextEdgeIndex( 0 ), mSampleNumber( 0 ), mBitState( BIT_LOW )
+{
+}
+
+CanEdgeBuffer::CanEdgeBuffer( const U64* edges, U64 num_edges, BitState initial_state, U64 num_samples )
+{
+    SetEdges( edges, num_edges, initial_state, num_samples );
+}
+
+void CanEdgeBuffer::SetEdges( const U64* edges, U64 num_edges, BitState initial_state, U64 num_samples )
+{
+    mEdges = edges;
+    mNumEdges = num_edges;
+    mNumSamples = num_samples;
+    mNextEdgeIndex = 0;
+    mSampleNumber = 0;
+    mBitState = initial_state;
+
+    // an edge on the first sample only sets the level.
+    if( mNumEdges > 0 && mEdges[ 0 ] == 0 )
+    {
+        mBitState = mBitState == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+        mNextEdgeIndex = 1;
+    }
+}
+
+U64 CanEdgeBuffer::GetSampleNumber() const
+{
+    return mSampleNumber;
+}
+
+BitState CanEdgeBuffer::GetBitState() const
+{
+    return mBitState;
+}
+
+void CanEdgeBuffer::AdvanceToNextEdge()
+{
+    if( mNextEdgeIndex >= mNumEdges || mEdges[ mNextEdgeIndex ] >= mNumSamples )
+        throw CanEndOfSamples();
+
+    mSampleNumber = mEdges[ mNextEdgeIndex++ ];
+    mBitState = mBitState == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+}
+
+U32 CanEdgeBuffer::AdvanceToAbsPosition( U64 sample )
+{
+    if( sample >= mNumSamples )
+        throw CanEndOfSamples();
+
+    U32 num_edges = 0;
+    while( mNextEdgeIndex < mNumEdges && mEdges[ mNextEdgeIndex ] <= sample )
+    {
+        mNextEdgeIndex++;
+        num_edges++;
+    }
+
+    if( ( num_edges & 1 ) != 0 )
+        mBitState = mBitState == BIT_HIGH ? BIT_LOW : BIT_HIGH;
+    mSampleNumber = sample;
+    return num_edges;
+}
+
+bool CanEdgeBuffer::WouldAdvancingCauseTransition( U32 num_samples ) const
+{
+    return mNextEdgeIndex < mNumEdges && mEdges[ mNextEdgeIndex ] < mNumSamples && mEdges[ mNextEdgeIndex ] <= mSampleNumber + num_samples;
+}
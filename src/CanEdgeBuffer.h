@@ -0,0 +1,31 @@
+#ifndef CAN_EDGE_BUFFER
+#define CAN_EDGE_BUFFER
+
+#include "CanOfflineChannel.h"
+
+// A capture held in memory as the sample numbers of its edges, in increasing order, with the level before the first edge.
+class CanEdgeBuffer : public CanOfflineChannel
+{
+  public:
+    CanEdgeBuffer();
+    // the edges aren't copied, and must outlive the buffer. the capture ends at num_samples, which is past the last edge.
+    CanEdgeBuffer( const U64* edges, U64 num_edges, BitState initial_state, U64 num_samples );
+
+    void SetEdges( const U64* edges, U64 num_edges, BitState initial_state, U64 num_samples );
+
+    virtual U64 GetSampleNumber() const;
+    virtual BitState GetBitState() const;
+    virtual void AdvanceToNextEdge();
+    virtual U32 AdvanceToAbsPosition( U64 sample );
+    virtual bool WouldAdvancingCauseTransition( U32 num_samples ) const;
+
+  protected:
+    const U64* mEdges;
+    U64 mNumEdges;
+    U64 mNumSamples;
+    U64 mNextEdgeIndex;
+    U64 mSampleNumber;
+    BitState mBitState;
+};
+
+#endif // CAN_EDGE_BUFFER
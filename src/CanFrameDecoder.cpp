@@ -0,0 +1,1119 @@
+#include "CanFrameDecoder.h"
+#include <AnalyzerHelpers.h>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    const U32 gCrcPolynomial = 0xC599; // x^15 + x^14 + x^10 + x^8 + x^7 + x^4 + x^3 + 1
+
+    // the CAN XL preface and frame CRCs, both shifted in from all ones. they cover the dynamic stuff bits of the arbitration
+    // phase, like the CAN FD CRC does, but not the fixed stuff bits of the data phase.
+    const U32 gXlPcrcPolynomial = 0x1909;     // x^13 + x^12 + x^11 + x^8 + x^3 + 1
+    const U32 gXlPcrcMask = 0x1FFF;
+    const U32 gXlFcrcPolynomial = 0xF1922815; // x^32 + x^31 + x^30 + x^29 + x^28 + x^24 + x^23 + x^20 + x^17 + x^13 + x^11 + x^4 + x^2 + 1
+
+    // maps a CRC-15 syndrome (received crc ^ computed crc) to the bit whose flip causes it, as one more than its distance back
+    // from the last CRC bit; 0 when no single bit error does. the polynomial's period is 127 bits, so every single bit
+    // error in a classical frame (at most 118 bits from the start of frame to the end of the crc) has its own syndrome.
+    struct CrcSyndromeTable
+    {
+        CrcSyndromeTable()
+        {
+            memset( mDistance, 0, sizeof( mDistance ) );
+
+            U32 syndrome = 1; // x^0, the last CRC bit
+            for( U32 distance = 0; distance < CAN_CRC_PERIOD_BITS; distance++ )
+            {
+                mDistance[ syndrome ] = U8( distance + 1 );
+
+                syndrome <<= 1;
+                if( ( syndrome & 0x8000 ) != 0 )
+                    syndrome ^= gCrcPolynomial;
+            }
+        }
+
+        U8 mDistance[ 1 << 15 ];
+    };
+
+    enum CanStuffing
+    {
+        NoStuffing,
+        DynamicStuffing, // a stuff bit after 5 equal bits
+        FixedStuffing    // a stuff bit after every CAN_XL_FIXED_STUFF_BITS bits, in the data phase of a CAN XL frame
+    };
+
+    // the CAN XL CRCs a field is covered by. what a frame turns out to be is only known at the XLF bit, so the fields before it
+    // are covered as well, whenever CAN XL frames are decoded.
+    enum CanXlCrc
+    {
+        NoXlCrc,
+        PrefaceAndFrameCrc, // SOF through SBC
+        FrameCrc            // the PCRC through the payload
+    };
+
+    // how each field is read: its length, how it is stuffed, whether the (classical) CRC covers it, which CAN XL CRCs cover it
+    // and whether its bits get sample point markers. what follows a field, and what it adds to the results, is up to
+    // CanFrameDecoder::EndField.
+    struct CanFieldSpec
+    {
+        U32 mNumBits;
+        CanStuffing mStuffing;
+        bool mCrc;
+        CanXlCrc mXlCrc;
+        bool mMarked;
+    };
+
+    // the payload and frame CRC of a CAN XL frame can run to thousands of bits at the data bit rate, too close together to
+    // see one by one, so they get no markers.
+    const CanFieldSpec gFieldSpecs[ NumCanFieldStates ] = {
+        { 1, DynamicStuffing, true, PrefaceAndFrameCrc, true },   // SofState
+        { 11, DynamicStuffing, true, PrefaceAndFrameCrc, true },  // IdentifierState
+        { 1, DynamicStuffing, true, PrefaceAndFrameCrc, true },   // SrrRtrState
+        { 1, DynamicStuffing, true, PrefaceAndFrameCrc, true },   // IdeState
+        { 18, DynamicStuffing, true, PrefaceAndFrameCrc, true },  // IdentifierExState
+        { 1, DynamicStuffing, true, PrefaceAndFrameCrc, true },   // RtrState
+        { 1, DynamicStuffing, true, PrefaceAndFrameCrc, true },   // R1State
+        { 1, DynamicStuffing, true, PrefaceAndFrameCrc, true },   // R0State
+        { 4, DynamicStuffing, true, NoXlCrc, true },              // DlcState
+        { 8, DynamicStuffing, true, NoXlCrc, true },              // DataState
+        { 15, DynamicStuffing, false, NoXlCrc, true },            // CrcState
+        { 1, DynamicStuffing, false, NoXlCrc, true },             // CrcDelimiterState
+        { 2, NoStuffing, false, NoXlCrc, true },                  // AckState, the slot and the delimiter
+        { 1, NoStuffing, false, NoXlCrc, false },                 // EofState, checked one bit at a time
+        { 1, DynamicStuffing, true, PrefaceAndFrameCrc, true },   // XlfState
+        { 1, DynamicStuffing, true, PrefaceAndFrameCrc, true },   // ResXlState
+        { 1, DynamicStuffing, true, PrefaceAndFrameCrc, true },   // AdhState, the switch to the data bit rate
+        { 3, NoStuffing, false, PrefaceAndFrameCrc, true },       // XlDhState, DH1, DH2 and DL1
+        { 8, FixedStuffing, false, PrefaceAndFrameCrc, true },    // SdtState
+        { 1, FixedStuffing, false, PrefaceAndFrameCrc, true },    // SecState
+        { 11, FixedStuffing, false, PrefaceAndFrameCrc, true },   // XlDlcState
+        { 3, FixedStuffing, false, PrefaceAndFrameCrc, true },    // SbcState
+        { 13, FixedStuffing, false, FrameCrc, true },             // PcrcState
+        { 8, FixedStuffing, false, FrameCrc, true },              // VcidState
+        { 32, FixedStuffing, false, FrameCrc, true },             // AfState
+        { 8, FixedStuffing, false, FrameCrc, false },             // XlDataState
+        { 32, FixedStuffing, false, NoXlCrc, false },             // FcrcState
+        { 4, NoStuffing, false, NoXlCrc, true },                  // FcpState
+        { 1, NoStuffing, false, NoXlCrc, true },                  // DahState, the switch back to the bit rate
+        { 3, NoStuffing, false, NoXlCrc, true },                  // XlAhState, AH1, AL1 and AH2
+    };
+
+    void UpdateXlCrcs( U32 bit, CanXlCrc crcs, U32& pcrc, U32& fcrc )
+    {
+        if( crcs == PrefaceAndFrameCrc )
+        {
+            U32 next_pcrc_bit = bit ^ ( pcrc >> 12 );
+            pcrc = ( ( pcrc << 1 ) & gXlPcrcMask ) ^ ( gXlPcrcPolynomial & -next_pcrc_bit );
+        }
+
+        U32 next_fcrc_bit = bit ^ ( fcrc >> 31 );
+        fcrc = ( fcrc << 1 ) ^ ( gXlFcrcPolynomial & -next_fcrc_bit );
+    }
+
+    const CrcSyndromeTable& GetCrcSyndromeTable()
+    {
+        static const CrcSyndromeTable table; // built once, on the first CRC error
+        return table;
+    }
+}
+
+const char* CanErrorTypeName( CanErrorType type )
+{
+    switch( type )
+    {
+    case StuffError:
+        return "stuff";
+    case FormError:
+        return "form";
+    case CrcError:
+        return "crc";
+    case AckError:
+        return "ack";
+    case ReservedBitError:
+        return "reserved_bit";
+    default:
+        return "unknown";
+    }
+}
+
+CanFrameDecoder::CanFrameDecoder()
+    : mChannel( NULL ),
+      mOfflineChannel( NULL ),
+      mMaxGlitchSamples( 0 ),
+      mLastEdge( 0 ),
+#ifdef CAN_DECODER_STATS
+      mStats( &mUnsharedStats ),
+#endif
+      mFrameComplete( false ),
+      mFrameBits( 0 ),
+      mFrameRawBits( 0 ),
+      mNumRawBits( 0 ),
+      mErrorFlag( false ),
+      mCanError( false ),
+      mErrorType( StuffError ),
+      mErrorBit( 0 ),
+      mHasSuspectBit( false ),
+      mSuspectBit( 0 )
+{
+}
+
+CanFrameDecoder::~CanFrameDecoder()
+{
+}
+
+void CanFrameDecoder::Init( AnalyzerChannelData* channel, const CanDecoderConfig& config )
+{
+    mChannel = channel;
+    mOfflineChannel = NULL;
+    Init( config );
+}
+
+void CanFrameDecoder::Init( CanOfflineChannel* channel, const CanDecoderConfig& config )
+{
+    mChannel = NULL;
+    mOfflineChannel = channel;
+    Init( config );
+}
+
+void CanFrameDecoder::Init( const CanDecoderConfig& config )
+{
+    mConfig = config;
+    mRecessive = config.mInverted ? BIT_LOW : BIT_HIGH;
+    mDominant = config.mInverted ? BIT_HIGH : BIT_LOW;
+
+    // a pulse lasting this many samples or fewer is a glitch.
+    U32 glitch_samples = U32( ceil( double( config.mGlitchFilterNs ) * double( config.mSampleRateHz ) * 1e-9 ) );
+    mMaxGlitchSamples = glitch_samples > 0 ? glitch_samples - 1 : 0;
+
+    InitSampleClock();
+}
+
+#ifdef CAN_DECODER_STATS
+void CanFrameDecoder::SetStats( CanDecoderStats* stats )
+{
+    mStats = stats;
+}
+#endif
+
+void CanFrameDecoder::AdvanceToStartOfFrame()
+{
+    if( GetChannelBitState() == mRecessive )
+        AdvanceChannelToNextValidEdge();
+    else
+        mLastEdge = GetChannelSampleNumber();
+}
+
+bool CanFrameDecoder::AdvanceToStartOfFrameBefore( U64 sample )
+{
+    for( ;; )
+    {
+        U64 current = GetChannelSampleNumber();
+        if( GetChannelBitState() == mDominant )
+        {
+            mLastEdge = current;
+            return current < sample;
+        }
+
+        if( current + 1 >= sample || WouldAdvancingChannelCauseTransition( U32( sample - current - 1 ) ) == false )
+            return false;
+
+        AdvanceChannelToNextEdge();
+        mLastEdge = GetChannelSampleNumber();
+        if( SkipGlitch() == false )
+            return true;
+    }
+}
+
+void CanFrameDecoder::AdvanceToSample( U64 sample )
+{
+    if( sample > GetChannelSampleNumber() )
+        AdvanceChannelToSample( sample );
+}
+
+void CanFrameDecoder::DecodeFrame()
+{
+    mFields.clear();
+    mFrameComplete = false;
+    mFrameBits = 0;
+    mFrameRawBits = 0;
+    mCanError = false;
+
+    // we're at the first DOMINANT edge of the frame; the polarity is dispatched once per frame. the bits are analyzed as they
+    // are captured.
+    if( mConfig.mInverted == true )
+        GetRawFrame<true>();
+    else
+        GetRawFrame<false>();
+
+    // the bits ran out before the frame was complete.
+    if( mFrameComplete == false && mCanError == false )
+        SetError( FormError, mRawFrameIndex, mEndOfRawFrame );
+
+    // an error runs to the end of the capture.
+    mErrorEndingSample = mEndOfRawFrame;
+}
+
+void CanFrameDecoder::AddReservedBitRecord( U64 ending_sample )
+{
+    // receivers have to accept recessive reserved bits, so this is reported without ending the frame; a frame that wasn't
+    // classical after all fails its CRC check further on.
+    AddFieldRecord( CanError, CAN_ERROR_DATA( ReservedBitError, mReservedErrorBit ), 0, mReservedErrorSample, ending_sample );
+}
+
+void CanFrameDecoder::SetError( CanErrorType type, U32 bit, U64 sample )
+{
+    mCanError = true;
+    mHasSuspectBit = false;
+    mErrorType = type;
+    mErrorBit = bit;
+    mErrorStartingSample = sample;
+}
+
+bool CanFrameDecoder::IsFrameComplete() const
+{
+    return mFrameComplete;
+}
+
+bool CanFrameDecoder::IsError() const
+{
+    return mCanError;
+}
+
+const std::vector<Frame>& CanFrameDecoder::GetFields() const
+{
+    return mFields;
+}
+
+const std::vector<CanMarker>& CanFrameDecoder::GetMarkers() const
+{
+    return mCanMarkers;
+}
+
+U64 CanFrameDecoder::GetStartOfFrame() const
+{
+    return mStartOfFrame;
+}
+
+U32 CanFrameDecoder::GetFrameBits() const
+{
+    return mFrameBits;
+}
+
+U32 CanFrameDecoder::GetErrorBits() const
+{
+    // an error flag was part of the raw frame; count the whole error frame in its place.
+    if( mErrorFlag == true )
+        return mNumRawBits - 6 + CAN_ERROR_FRAME_BITS + CAN_INTERMISSION_BITS;
+    return mNumRawBits + CAN_INTERMISSION_BITS;
+}
+
+U32 CanFrameDecoder::GetOccupiedBits() const
+{
+    if( mFrameComplete == false )
+        return GetErrorBits();
+    if( mCanError == false )
+        return mFrameBits;
+
+    // flagged after its ACK slot: the frame counts through its intermission, plus whatever the error frame runs past that.
+    U32 error_bits = GetErrorBits();
+    U32 frame_raw_bits = mFrameRawBits + CAN_EOF_BITS + CAN_INTERMISSION_BITS;
+    return error_bits > frame_raw_bits ? mFrameBits + error_bits - frame_raw_bits : mFrameBits;
+}
+
+bool CanFrameDecoder::SawErrorFlag() const
+{
+    return mErrorFlag;
+}
+
+CanErrorType CanFrameDecoder::GetErrorType() const
+{
+    return mErrorType;
+}
+
+U32 CanFrameDecoder::GetErrorBit() const
+{
+    return mErrorBit;
+}
+
+bool CanFrameDecoder::GetErrorSuspectBit( U32& bit, U64& sample ) const
+{
+    if( mCanError == false || mHasSuspectBit == false )
+        return false;
+
+    bit = mSuspectBit;
+    sample = mSuspectSample;
+    return true;
+}
+
+U64 CanFrameDecoder::GetErrorStartingSample() const
+{
+    return mErrorStartingSample;
+}
+
+U64 CanFrameDecoder::GetErrorEndingSample() const
+{
+    return mErrorEndingSample;
+}
+
+bool CanFrameDecoder::GetMessage( CanMessage& message ) const
+{
+    if( mFrameComplete == false )
+        return false;
+
+    message.mNumDataBytes = 0;
+    message.mPayloadHash = CAN_PAYLOAD_HASH_START;
+
+    U32 count = mFields.size();
+    for( U32 i = 0; i < count; i++ )
+    {
+        const Frame& frame = mFields[ i ];
+        switch( frame.mType )
+        {
+        case IdentifierField:
+        case IdentifierFieldEx:
+            message.mIdentifier = U32( frame.mData1 );
+            message.mExtended = frame.mType == IdentifierFieldEx;
+            message.mRemoteFrame = ( frame.mFlags & REMOTE_FRAME ) != 0;
+            message.mStartingSample = frame.mStartingSampleInclusive;
+            break;
+        case ControlField:
+            message.mDlc = U32( frame.mData1 );
+            break;
+        case XlControlField:
+            message.mDlc = CAN_XL_DLC( frame.mData1 );
+            break;
+        case DataField:
+            if( message.mNumDataBytes < sizeof( message.mData ) )
+                message.mData[ message.mNumDataBytes++ ] = U8( frame.mData1 );
+            message.mPayloadHash = CAN_PAYLOAD_HASH( message.mPayloadHash, frame.mData1 );
+            break;
+        case AckField:
+            message.mEndingSample = frame.mEndingSampleInclusive;
+            break;
+        }
+    }
+
+    return true;
+}
+
+void CanFrameDecoder::InitSampleClock()
+{
+    SetSampleClockRate( mConfig.mBitRate );
+    mNumSamplesIn7Bits = U32( U64( mConfig.mSampleRateHz ) * 7 / mConfig.mBitRate );
+}
+
+void CanFrameDecoder::SetSampleClockRate( U32 bit_rate )
+{
+    // the sample clock counts in 1 / ( 2 * bit rate ) samples, so half a bit and a whole bit are both exact.
+    mSampleClockModulus = 2 * U64( bit_rate );
+    mSamplesPerBit = U64( mConfig.mSampleRateHz ) / bit_rate;
+    mSamplePhasePerBit = 2 * ( U64( mConfig.mSampleRateHz ) % bit_rate );
+}
+
+void CanFrameDecoder::SyncSampleClock( U64 sample, U32 half_bits )
+{
+    // the next sample point is this many half bits after the sample.
+    U64 phase = U64( half_bits ) * mConfig.mSampleRateHz;
+    mNextSamplePoint = sample + phase / mSampleClockModulus;
+    mSamplePhase = phase % mSampleClockModulus;
+}
+
+void CanFrameDecoder::AdvanceSampleClock()
+{
+    mNextSamplePoint += mSamplesPerBit;
+    mSamplePhase += mSamplePhasePerBit;
+    if( mSamplePhase >= mSampleClockModulus )
+    {
+        mSamplePhase -= mSampleClockModulus;
+        mNextSamplePoint++;
+    }
+}
+
+void CanFrameDecoder::WaitFor7RecessiveBits()
+{
+    if( GetChannelBitState() == mDominant )
+        AdvanceChannelToNextValidEdge();
+
+    if( mMaxGlitchSamples == 0 )
+    {
+        for( ;; )
+        {
+            if( WouldAdvancingChannelCauseTransition( mNumSamplesIn7Bits ) == false )
+                return;
+
+            AdvanceChannelToNextEdge();
+            AdvanceChannelToNextEdge();
+        }
+    }
+
+    // a glitch doesn't end the recessive run, so count from where it really started.
+    U64 recessive_start = GetChannelSampleNumber();
+    for( ;; )
+    {
+        U64 current = GetChannelSampleNumber();
+        U64 run_end = recessive_start + mNumSamplesIn7Bits;
+        if( run_end <= current || WouldAdvancingChannelCauseTransition( U32( run_end - current ) ) == false )
+            return;
+
+        AdvanceChannelToNextEdge();
+        if( SkipGlitch() == true )
+            continue;
+
+        AdvanceChannelToNextValidEdge();
+        recessive_start = mLastEdge;
+    }
+}
+
+template <bool Inverted>
+void CanFrameDecoder::GetRawFrame()
+{
+    // the polarity is fixed for the whole capture: the run detection compares against a constant, and the captured line levels are
+    // turned into bus levels (1 is RECESSIVE) with one XOR per word before they are analyzed.
+    const U64 recessive_level = Inverted ? 0 : 1;
+    const U64 polarity = Inverted ? ~0ull : 0ull;
+
+    mErrorFlag = false;
+    mNumRawBits = 0;
+    ResetFieldState();
+
+    if( GetChannelBitState() != mDominant )
+        AnalyzerHelpers::Assert( "GetFrameOrError assumes we start DOMINANT" );
+
+    mStartOfFrame = mLastEdge; // a glitch right after the edge may have moved the channel past it
+    SetSampleClockRate( mConfig.mBitRate );
+    SyncSampleClock( mStartOfFrame, 1 );
+    CAN_STATS( mStats->mResyncs++ ); // hard synchronization on the start of frame edge.
+
+    U64 run_level = recessive_level ^ 1; // the start of frame; no resynchronization until a recessive bit
+    U32 run_length = 0;
+    U64 word = 0;
+    U32 word_bits = 0;
+    U32 budget = GetCaptureBudget();
+
+    // what we're going to do now is capture a sequence up until we get 7 recessive bits in a row, or 6 dominant ones.
+    for( ;; )
+    {
+        U64 sample = mNextSamplePoint;
+
+        // resynchronize on the first edge after a recessive bit, which can only be a RECESSIVE to DOMINANT edge.
+        bool edge = run_level == recessive_level && AdvanceToEdgeBefore( sample );
+        U64 level = SampleChannel( sample ) == BIT_HIGH ? 1 : 0;
+
+        if( edge == true && level != recessive_level )
+        {
+            SyncSampleClock( mLastEdge, 3 ); // the sample point of the bit after the one that started at the edge
+            CAN_STATS( mStats->mResyncs++ );
+        }
+        else
+        {
+            AdvanceSampleClock();
+        }
+
+        mWordSamples[ word_bits ] = sample;
+        word |= level << word_bits;
+        word_bits++;
+        mNumRawBits++;
+
+        if( level != run_level )
+        {
+            run_level = level;
+            run_length = 0;
+        }
+        run_length++;
+
+        // the data phase of a CAN XL frame allows longer runs, and only the analysis knows where that is; it gets the bits first.
+        bool end_of_run = run_length >= ( level == recessive_level ? 7 : 6 );
+
+        if( end_of_run == true || word_bits == budget )
+        {
+            FeedRawWord( word ^ polarity, word_bits );
+            word = 0;
+            word_bits = 0;
+            budget = GetCaptureBudget();
+        }
+
+        if( end_of_run == true && ( mXlDataPhase == false || mFeeding == false ) )
+        {
+            // we're done, unless this is an error flag or a dominant stuff error. the bits stay in the frame so the analysis can
+            // tell which.
+            mErrorFlag = level != recessive_level;
+            break;
+        }
+    }
+
+    mEndOfRawFrame = mNextSamplePoint;
+}
+
+bool CanFrameDecoder::AdvanceToEdgeBefore( U64 sample )
+{
+    for( ;; )
+    {
+        U64 current = GetChannelSampleNumber();
+        if( current >= sample || WouldAdvancingChannelCauseTransition( U32( sample - current ) ) == false )
+            return false;
+
+        AdvanceChannelToNextEdge();
+        mLastEdge = GetChannelSampleNumber();
+        if( SkipGlitch() == false )
+            return true;
+    }
+}
+
+U32 CanFrameDecoder::GetCaptureBudget() const
+{
+    // how many bits the capture can take before handing them over. a CAN XL field can change the bit timing, so with CAN XL on the
+    // analysis gets the bits at the end of each field at the latest.
+    if( mFeeding == false || mConfig.mXlDataBitRate == 0 )
+        return 64;
+
+    U32 left = gFieldSpecs[ mFieldState ].mNumBits - mFieldBits;
+    return left < 64 ? left : 64;
+}
+
+void CanFrameDecoder::ResetFieldState()
+{
+    mFeeding = true;
+    mXl = false;
+    mXlDataPhase = false;
+    mRawFrameIndex = 0;
+    mFieldState = SofState;
+    mFieldBits = 0;
+    mFieldValue = 0;
+    mRunBit = 1;
+    mRunLength = 0;
+    mCanMarkers.clear();
+    mComputedCrc = 0;
+    mComputedPcrc = gXlPcrcMask;
+    mComputedFcrc = 0xFFFFFFFF;
+    mDestuffedBits.clear();
+}
+
+void CanFrameDecoder::FeedRawWord( U64 word, U32 num_bits )
+{
+    // once the analysis is over, the rest of the capture only has to find the end of the frame.
+    for( U32 i = 0; i < num_bits && mFeeding == true; i++ )
+    {
+        if( FeedRawBit( U32( word >> i ) & 1, mWordSamples[ i ] ) == false )
+            mFeeding = false;
+        else
+            mRawFrameIndex++;
+    }
+}
+
+bool CanFrameDecoder::FeedRawBit( U32 bit, U64 sample )
+{
+    const CanFieldSpec& spec = gFieldSpecs[ mFieldState ];
+
+    if( spec.mStuffing == DynamicStuffing )
+    {
+        if( mRunLength == 5 )
+        {
+            // a stuff bit, which must be the opposite of the run.
+            if( bit == mRunBit )
+            {
+                SetError( StuffError, mRawFrameIndex, sample );
+                return false;
+            }
+
+            mRunBit = bit;
+            mRunLength = 1; // the stuff bit counts twards the next bit stuff
+            if( spec.mXlCrc != NoXlCrc && mConfig.mXlDataBitRate != 0 )
+                UpdateXlCrcs( bit, spec.mXlCrc, mComputedPcrc, mComputedFcrc );
+            mCanMarkers.push_back( CanMarker( sample, BitStuff ) );
+            CAN_STATS( mStats->mStuffBits++ );
+            return true;
+        }
+
+        if( bit == mRunBit )
+        {
+            mRunLength++;
+        }
+        else
+        {
+            mRunBit = bit;
+            mRunLength = 1;
+        }
+
+        mDestuffedBits.push_back( mRawFrameIndex );
+    }
+    else if( spec.mStuffing == FixedStuffing )
+    {
+        if( mFixedStuffCount == CAN_XL_FIXED_STUFF_BITS )
+        {
+            // a fixed stuff bit, which must be the opposite of the bit before it.
+            if( bit == mRunBit )
+            {
+                SetError( StuffError, mRawFrameIndex, sample );
+                return false;
+            }
+
+            mRunBit = bit;
+            mFixedStuffCount = 0;
+            if( spec.mMarked == true )
+                mCanMarkers.push_back( CanMarker( sample, BitStuff ) );
+            CAN_STATS( mStats->mStuffBits++ );
+            return true;
+        }
+
+        mRunBit = bit;
+        mFixedStuffCount++;
+    }
+
+    if( spec.mCrc == true )
+    {
+        // CRC-15, x^15 + x^14 + x^10 + x^8 + x^7 + x^4 + x^3 + 1
+        U32 next_bit = bit ^ ( mComputedCrc >> 14 );
+        mComputedCrc = ( ( mComputedCrc << 1 ) & 0x7FFF ) ^ ( 0x4599 & -next_bit );
+    }
+
+    if( spec.mXlCrc != NoXlCrc && mConfig.mXlDataBitRate != 0 )
+        UpdateXlCrcs( bit, spec.mXlCrc, mComputedPcrc, mComputedFcrc );
+
+    if( spec.mMarked == true )
+        mCanMarkers.push_back( CanMarker( sample, Standard ) );
+
+    if( mFieldBits == 0 )
+    {
+        mFieldStartBit = mRawFrameIndex;
+        mFieldStartSample = sample;
+    }
+
+    mFieldValue = ( mFieldValue << 1 ) | bit;
+    mFieldBits++;
+
+    if( mFieldBits < spec.mNumBits )
+        return true;
+
+    U32 value = mFieldValue;
+    mFieldBits = 0;
+    mFieldValue = 0;
+    return EndField( value, sample );
+}
+
+bool CanFrameDecoder::EndField( U32 value, U64 last_sample )
+{
+    switch( mFieldState )
+    {
+    case SofState:
+        mFieldState = IdentifierState;
+        break;
+
+    case IdentifierState:
+        mIdentifier = value;
+        mIdentifierStartSample = mFieldStartSample;
+        mFieldState = SrrRtrState;
+        break;
+
+    case SrrRtrState:
+        mRemoteFrame = value != 0; // the RTR bit for 11-bit CAN, SRR for 29-bit CAN
+        mFieldState = IdeState;
+        break;
+
+    case IdeState:
+        // if the IDE bit is dominant, then this is 11-bit. the frame format is dispatched on here, once per frame, by
+        // picking the fields that follow; the per-bit loop never looks at it.
+        mExtended = value != 0;
+        mReservedErrorBit = 0;
+        mFieldState = mExtended ? IdentifierExState : R0State;
+        break;
+
+    case IdentifierExState:
+        mIdentifier = ( mIdentifier << 18 ) | value;
+        mFieldState = RtrState;
+        break;
+
+    case RtrState:
+        mRemoteFrame = value != 0;
+        mFieldState = R1State;
+        break;
+
+    case R1State:
+        if( value != 0 )
+        {
+            mReservedErrorBit = mFieldStartBit;
+            mReservedErrorSample = mFieldStartSample;
+        }
+        mFieldState = R0State;
+        break;
+
+    case R0State:
+        if( value != 0 && mReservedErrorBit == 0 )
+        {
+            mReservedErrorBit = mFieldStartBit;
+            mReservedErrorSample = mFieldStartSample;
+        }
+
+        // a recessive r0 is the FDF bit of an FD or XL frame.
+        if( value != 0 && mExtended == false && mConfig.mXlDataBitRate != 0 )
+        {
+            mFieldState = XlfState;
+            break;
+        }
+
+        AddFieldRecord( mExtended ? IdentifierFieldEx : IdentifierField, mIdentifier, mRemoteFrame ? REMOTE_FRAME : 0,
+                        mIdentifierStartSample, last_sample );
+
+        // the reserved bits should be dominant.
+        if( mReservedErrorBit != 0 )
+            AddReservedBitRecord( last_sample );
+        mFieldState = DlcState;
+        break;
+
+    case DlcState:
+        mNumDataBytes = value;
+        AddFieldRecord( ControlField, value, 0, mFieldStartSample, last_sample );
+
+        mDataBytesLeft = value > 8 ? 8 : value;
+        if( mRemoteFrame == true )
+            mDataBytesLeft = 0; // ignore the num_bytes if this is a remote frame.
+
+        mFieldState = mDataBytesLeft > 0 ? DataState : CrcState;
+        break;
+
+    case DataState:
+    case XlDataState:
+        // the payload of a CAN XL frame is streamed out a byte at a time, like any other.
+        AddFieldRecord( DataField, value, 0, mFieldStartSample, last_sample );
+        mDataBytesLeft--;
+        if( mDataBytesLeft == 0 )
+            mFieldState = mXl ? FcrcState : CrcState;
+        break;
+
+    case CrcState:
+        mCrcValue = value;
+        AddFieldRecord( CrcField, value, 0, mFieldStartSample, last_sample );
+
+        if( mCrcValue != mComputedCrc )
+        {
+            SetError( CrcError, mFieldStartBit, mFieldStartSample );
+            LocateCrcError();
+            return false;
+        }
+        mFieldState = CrcDelimiterState;
+        break;
+
+    case CrcDelimiterState:
+        if( value == 0 )
+        {
+            SetError( FormError, mFieldStartBit, last_sample );
+            return false;
+        }
+        mFieldState = AckState;
+        break;
+
+    case AckState:
+    {
+        // the ACK slot, then the ACK delimiter.
+        U32 ack_bit = mFieldStartBit;
+        mAck = ( value & 2 ) == 0;
+
+        AddFieldRecord( AckField, mAck, 0, mFieldStartSample, last_sample );
+        mFrameComplete = true;
+        mFrameRawBits = mRawFrameIndex + 1; // raw bits so far run through the ACK delimiter
+        mFrameBits = mFrameRawBits + CAN_EOF_BITS + CAN_INTERMISSION_BITS;
+
+        // the data phase of a CAN XL frame is faster; count the bus time it took in bits at the bit rate.
+        if( mXl == true )
+            mFrameBits = U32( ( last_sample - mStartOfFrame ) * mConfig.mBitRate / mConfig.mSampleRateHz ) + 1 + CAN_EOF_BITS +
+                         CAN_INTERMISSION_BITS;
+
+        // the message is complete; anything wrong from here on is still reported, after it.
+        if( mAck == false )
+        {
+            SetError( AckError, ack_bit, mFieldStartSample );
+            return false;
+        }
+
+        if( ( value & 1 ) == 0 )
+        {
+            SetError( FormError, ack_bit + 1, last_sample );
+            return false;
+        }
+
+        mEofBits = 0;
+        mFieldState = EofState;
+        break;
+    }
+
+    case EofState:
+        // the capture stops after the ACK delimiter and 6 recessive bits, so the last EOF bit (where dominant means overload) isn't
+        // seen.
+        if( value == 0 )
+        {
+            SetError( FormError, mFieldStartBit, last_sample );
+            return false;
+        }
+
+        mEofBits++;
+        return mEofBits < CAN_EOF_BITS;
+
+    case XlfState:
+        // FD frames aren't decoded; their FDF bit is reported as a recessive r0, and the frame is read on as a classical frame,
+        // where this bit was the first bit of the DLC.
+        if( value == 0 )
+        {
+            AddFieldRecord( IdentifierField, mIdentifier, mRemoteFrame ? REMOTE_FRAME : 0, mIdentifierStartSample, mReservedErrorSample );
+            AddReservedBitRecord( mReservedErrorSample );
+            mFieldState = DlcState;
+            mFieldBits = 1;
+            mFieldValue = 0;
+            break;
+        }
+
+        AddFieldRecord( IdentifierField, mIdentifier, XL_FRAME, mIdentifierStartSample, last_sample );
+
+        mXl = true;
+        mFieldState = ResXlState;
+        break;
+
+    case ResXlState:
+        if( value != 0 )
+        {
+            SetError( ReservedBitError, mFieldStartBit, mFieldStartSample );
+            return false;
+        }
+        mFieldState = AdhState;
+        break;
+
+    case AdhState:
+        if( value == 0 )
+        {
+            SetError( FormError, mFieldStartBit, last_sample );
+            return false;
+        }
+
+        // the data phase starts at the end of the ADH bit, at the data bit rate.
+        SyncSampleClock( last_sample, 1 );
+        SetSampleClockRate( mConfig.mXlDataBitRate );
+        SyncSampleClock( mNextSamplePoint, 1 );
+        mXlDataPhase = true;
+        mFieldState = XlDhState;
+        break;
+
+    case XlDhState:
+        mFixedStuffCount = 0;
+        mFieldState = SdtState;
+        break;
+
+    case SdtState:
+        mXlSdt = value;
+        mXlFieldStartSample = mFieldStartSample;
+        mFieldState = SecState;
+        break;
+
+    case SecState:
+        mXlSec = value;
+        mFieldState = XlDlcState;
+        break;
+
+    case XlDlcState:
+        mXlDlc = value;
+        mFieldState = SbcState;
+        break;
+
+    case SbcState:
+        mNumDataBytes = mXlDlc + 1;
+        AddFieldRecord( XlControlField, CAN_XL_CONTROL_DATA( mXlSdt, mXlSec, mXlDlc, value ), 0, mXlFieldStartSample, last_sample );
+        mFieldState = PcrcState;
+        break;
+
+    case PcrcState:
+        AddFieldRecord( XlPcrcField, value, 0, mFieldStartSample, last_sample );
+        if( value != mComputedPcrc )
+        {
+            SetError( CrcError, mFieldStartBit, mFieldStartSample );
+            return false;
+        }
+        mFieldState = VcidState;
+        break;
+
+    case VcidState:
+        mXlVcid = value;
+        mXlFieldStartSample = mFieldStartSample;
+        mFieldState = AfState;
+        break;
+
+    case AfState:
+        AddFieldRecord( XlAddressField, CAN_XL_ADDRESS_DATA( mXlVcid, value ), 0, mXlFieldStartSample, last_sample );
+        mDataBytesLeft = mNumDataBytes;
+        mFieldState = XlDataState;
+        break;
+
+    case FcrcState:
+        AddFieldRecord( XlFcrcField, value, 0, mFieldStartSample, last_sample );
+        if( value != mComputedFcrc )
+        {
+            SetError( CrcError, mFieldStartBit, mFieldStartSample );
+            return false;
+        }
+        mFieldState = FcpState;
+        break;
+
+    case FcpState:
+        if( value != CAN_XL_FORMAT_CHECK_PATTERN )
+        {
+            SetError( FormError, mFieldStartBit, mFieldStartSample );
+            return false;
+        }
+        mFieldState = DahState;
+        break;
+
+    case DahState:
+        if( value == 0 )
+        {
+            SetError( FormError, mFieldStartBit, last_sample );
+            return false;
+        }
+
+        // back to the bit rate at the end of the DAH bit.
+        SyncSampleClock( last_sample, 1 );
+        SetSampleClockRate( mConfig.mBitRate );
+        SyncSampleClock( mNextSamplePoint, 1 );
+        mXlDataPhase = false;
+        mFieldState = XlAhState;
+        break;
+
+    case XlAhState:
+        mFieldState = AckState;
+        break;
+
+    default:
+        return false;
+    }
+
+    return true;
+}
+
+void CanFrameDecoder::AddFieldRecord( U8 type, U64 data, U8 flags, U64 starting_sample, U64 ending_sample )
+{
+    Frame frame;
+    frame.mStartingSampleInclusive = starting_sample;
+    frame.mEndingSampleInclusive = ending_sample;
+    frame.mType = type;
+    frame.mFlags = flags;
+    frame.mData1 = data;
+    mFields.push_back( frame );
+}
+
+void CanFrameDecoder::LocateCrcError()
+{
+    // called right after the CRC sequence, so the destuffed bits so far are exactly the bits the CRC covers, plus the CRC.
+    U32 distance = GetCrcSyndromeTable().mDistance[ mCrcValue ^ mComputedCrc ];
+    U32 num_bits = mDestuffedBits.size();
+    if( distance == 0 || distance > num_bits )
+        return;
+
+    // every raw bit up to here has its sample point marker.
+    mSuspectBit = mDestuffedBits[ num_bits - distance ];
+    mSuspectSample = mCanMarkers[ mSuspectBit ].mSample;
+    mHasSuspectBit = true;
+}
+
+// the channel is either the SDK's or an offline one; each call picks one with a branch that always goes the same way.
+
+U64 CanFrameDecoder::GetChannelSampleNumber()
+{
+    if( mOfflineChannel != NULL )
+        return mOfflineChannel->GetSampleNumber();
+    return mChannel->GetSampleNumber();
+}
+
+BitState CanFrameDecoder::GetChannelBitState()
+{
+    if( mOfflineChannel != NULL )
+        return mOfflineChannel->GetBitState();
+    return mChannel->GetBitState();
+}
+
+void CanFrameDecoder::AdvanceChannelToNextEdge()
+{
+    CAN_STATS( mStats->mChannelSeeks++ );
+    CAN_STATS( mStats->mEdgesConsumed++ );
+    if( mOfflineChannel != NULL )
+        mOfflineChannel->AdvanceToNextEdge();
+    else
+        mChannel->AdvanceToNextEdge();
+}
+
+void CanFrameDecoder::AdvanceChannelToSample( U64 sample )
+{
+#ifdef CAN_DECODER_STATS
+    mStats->mChannelSeeks++;
+    if( mOfflineChannel != NULL )
+        mStats->mEdgesConsumed += mOfflineChannel->AdvanceToAbsPosition( sample );
+    else
+        mStats->mEdgesConsumed += mChannel->AdvanceToAbsPosition( sample );
+#else
+    if( mOfflineChannel != NULL )
+        mOfflineChannel->AdvanceToAbsPosition( sample );
+    else
+        mChannel->AdvanceToAbsPosition( sample );
+#endif
+}
+
+bool CanFrameDecoder::WouldAdvancingChannelCauseTransition( U32 num_samples )
+{
+    CAN_STATS( mStats->mChannelSeeks++ );
+    if( mOfflineChannel != NULL )
+        return mOfflineChannel->WouldAdvancingCauseTransition( num_samples );
+    return mChannel->WouldAdvancingCauseTransition( num_samples );
+}
+
+void CanFrameDecoder::AdvanceChannelToNextValidEdge()
+{
+    for( ;; )
+    {
+        AdvanceChannelToNextEdge();
+        mLastEdge = GetChannelSampleNumber();
+        if( SkipGlitch() == false )
+            return;
+    }
+}
+
+bool CanFrameDecoder::SkipGlitch()
+{
+    // called on an edge. returns true when the edge started a pulse no wider than the filter; the pulse is stepped over and the
+    // channel is back in its previous state. when the pulse after that is short too, it is taken as the glitch instead, and
+    // the channel is left past it, in the state this edge started.
+    if( mMaxGlitchSamples == 0 || WouldAdvancingChannelCauseTransition( mMaxGlitchSamples ) == false )
+        return false;
+
+    AdvanceChannelToNextEdge();
+    CAN_STATS( mStats->mGlitches++ );
+
+    if( WouldAdvancingChannelCauseTransition( mMaxGlitchSamples ) == false )
+        return true;
+
+    AdvanceChannelToNextEdge();
+    return false;
+}
+
+BitState CanFrameDecoder::SampleChannel( U64 sample )
+{
+    if( mMaxGlitchSamples == 0 )
+    {
+        AdvanceChannelToSample( sample );
+        return GetChannelBitState();
+    }
+
+    // walk the edges up to the sample point so a glitch around it can't flip the bit. stepping over a glitch that ends after
+    // the sample point leaves the channel just past it, already in the right state.
+    for( ;; )
+    {
+        U64 current = GetChannelSampleNumber();
+        if( current >= sample )
+            break;
+
+        if( WouldAdvancingChannelCauseTransition( U32( sample - current ) ) == false )
+        {
+            AdvanceChannelToSample( sample );
+            break;
+        }
+
+        AdvanceChannelToNextEdge();
+        SkipGlitch();
+    }
+
+    return GetChannelBitState();
+}
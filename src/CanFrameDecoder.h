@@ -0,0 +1,236 @@
+#ifndef CAN_FRAME_DECODER
+#define CAN_FRAME_DECODER
+
+#include <AnalyzerChannelData.h>
+#include "CanAnalyzerResults.h"
+#include "CanDecoderStats.h"
+#include "CanMessage.h"
+#include "CanOfflineChannel.h"
+#include <vector>
+
+// bus time that follows the decoded bits of a frame, for bus load accounting.
+#define CAN_EOF_BITS 7
+#define CAN_INTERMISSION_BITS 3
+#define CAN_ERROR_FRAME_BITS 14 // 6 bit error flag and 8 bit error delimiter
+
+// single bit CRC errors can be told apart within this many bits, up to the end of the CRC sequence.
+#define CAN_CRC_PERIOD_BITS 127
+
+// the data phase of a CAN XL frame has a stuff bit after every this many bits, and ends with a fixed format check pattern.
+#define CAN_XL_FIXED_STUFF_BITS 10
+#define CAN_XL_FORMAT_CHECK_PATTERN 0xC
+
+enum CanBitType
+{
+    Standard,
+    BitStuff
+};
+
+
+// the fields of a frame, in the order they are read from the destuffed bits.
+enum CanFieldState
+{
+    SofState,
+    IdentifierState,
+    SrrRtrState,
+    IdeState,
+    IdentifierExState,
+    RtrState,
+    R1State,
+    R0State,
+    DlcState,
+    DataState,
+    CrcState,
+    CrcDelimiterState,
+    AckState,
+    EofState,
+
+    // CAN XL, from the XLF bit that follows a recessive r0 (FDF) bit.
+    XlfState,
+    ResXlState,
+    AdhState,
+    XlDhState,
+    SdtState,
+    SecState,
+    XlDlcState,
+    SbcState,
+    PcrcState,
+    VcidState,
+    AfState,
+    XlDataState,
+    FcrcState,
+    FcpState,
+    DahState,
+    XlAhState,
+
+    NumCanFieldStates
+};
+
+class CanMarker
+{
+  public:
+    CanMarker( U64 sample, enum CanBitType type )
+    {
+        mSample = sample;
+        mType = type;
+    }
+
+    U64 mSample;
+    enum CanBitType mType;
+};
+
+struct CanDecoderConfig
+{
+    U32 mSampleRateHz;
+    U32 mBitRate;
+    bool mInverted;
+    U32 mGlitchFilterNs; // pulses shorter than this are ignored, 0 to keep every edge
+    U32 mXlDataBitRate;  // 0 when CAN XL frames aren't decoded
+};
+
+// Bit-level decoding of one CAN channel.
+//
+// Each call to DecodeFrame samples one frame from the channel, removes the stuff bits and splits it into field records
+// (the same Frame records the analyzer adds to its results), along with the sample point markers. The decoder doesn't
+// touch any results itself, so the analyzer can run one per channel. Offline, it reads a CanOfflineChannel instead.
+class CanFrameDecoder
+{
+  public:
+    CanFrameDecoder();
+    ~CanFrameDecoder();
+
+    void Init( AnalyzerChannelData* channel, const CanDecoderConfig& config );
+    void Init( CanOfflineChannel* channel, const CanDecoderConfig& config ); // past the last sample, throws CanEndOfSamples
+#ifdef CAN_DECODER_STATS
+    void SetStats( CanDecoderStats* stats );
+#endif
+
+    void WaitFor7RecessiveBits();
+    void AdvanceToStartOfFrame();
+    bool AdvanceToStartOfFrameBefore( U64 sample ); // false when no frame starts before sample
+    void AdvanceToSample( U64 sample );
+    void DecodeFrame();
+
+    bool IsFrameComplete() const;
+    bool IsError() const;
+    const std::vector<Frame>& GetFields() const;
+    const std::vector<CanMarker>& GetMarkers() const;
+    U64 GetStartOfFrame() const;
+    U32 GetFrameBits() const; // through the intermission; valid for a complete frame
+    bool SawErrorFlag() const; // the bus is in an error frame; wait for it to go idle
+    CanErrorType GetErrorType() const;
+    U32 GetErrorBit() const; // counted from the start of frame, including stuff bits
+    bool GetErrorSuspectBit( U32& bit, U64& sample ) const; // the bit that, flipped, would explain a CRC error
+    U32 GetErrorBits() const; // bus time taken by the frame and its error frame
+    U32 GetOccupiedBits() const; // bus time to charge the frame with, counted once when it's both complete and in error
+    U64 GetErrorStartingSample() const;
+    U64 GetErrorEndingSample() const;
+    bool GetMessage( CanMessage& message ) const; // false unless the frame is complete
+
+  protected: // functions
+    void Init( const CanDecoderConfig& config );
+    void InitSampleClock();
+    void SetSampleClockRate( U32 bit_rate );
+    void SyncSampleClock( U64 sample, U32 half_bits );
+    void AdvanceSampleClock();
+    template <bool Inverted>
+    void GetRawFrame();
+    bool AdvanceToEdgeBefore( U64 sample );
+    void ResetFieldState();
+    U32 GetCaptureBudget() const;
+    void FeedRawWord( U64 word, U32 num_bits );
+    bool FeedRawBit( U32 bit, U64 sample );      // false once the frame is over, or in error
+    bool EndField( U32 value, U64 last_sample ); // same; picks the next field
+    void AddFieldRecord( U8 type, U64 data, U8 flags, U64 starting_sample, U64 ending_sample );
+    void AddReservedBitRecord( U64 ending_sample ); // a CanError record that doesn't end the frame
+    void SetError( CanErrorType type, U32 bit, U64 sample );
+    void LocateCrcError();
+
+    U64 GetChannelSampleNumber();
+    BitState GetChannelBitState();
+    void AdvanceChannelToNextEdge();
+    void AdvanceChannelToSample( U64 sample );
+    bool WouldAdvancingChannelCauseTransition( U32 num_samples );
+    void AdvanceChannelToNextValidEdge();
+    bool SkipGlitch();
+    BitState SampleChannel( U64 sample );
+
+  protected: // vars
+    AnalyzerChannelData* mChannel; // NULL when decoding mOfflineChannel
+    CanOfflineChannel* mOfflineChannel;
+    CanDecoderConfig mConfig;
+    BitState mRecessive;
+    BitState mDominant;
+    U32 mMaxGlitchSamples; // 0 when the glitch filter is off
+    U64 mLastEdge;         // the last edge the glitch filter accepted
+#ifdef CAN_DECODER_STATS
+    CanDecoderStats* mStats;
+    CanDecoderStats mUnsharedStats; // counted into when no stats are set
+#endif
+
+    std::vector<Frame> mFields;
+    bool mFrameComplete;
+    U32 mFrameBits;
+    U32 mFrameRawBits; // raw bits through the ACK delimiter, of a complete frame
+
+    // the next sample point is mNextSamplePoint + mSamplePhase / mSampleClockModulus samples.
+    U64 mNextSamplePoint;
+    U64 mSamplePhase;
+    U64 mSampleClockModulus;
+    U64 mSamplesPerBit;
+    U64 mSamplePhasePerBit;
+    U64 mWordSamples[ 64 ]; // sample points of the raw bits waiting to be analyzed
+    U64 mEndOfRawFrame;     // the sample point after the last raw bit
+
+    U32 mNumSamplesIn7Bits;
+    U32 mRunBit; // the level of the current run of destuffed bits, 1 for RECESSIVE
+    U32 mRunLength;
+    U32 mRawFrameIndex;
+    bool mFeeding; // the analysis still wants raw bits
+    U64 mStartOfFrame;
+    U32 mIdentifier;
+    U32 mCrcValue;
+    U32 mComputedCrc;
+    U32 mComputedPcrc; // the CAN XL CRCs, only kept up when CAN XL frames are decoded
+    U32 mComputedFcrc;
+    bool mAck;
+
+    CanFieldState mFieldState;
+    U32 mFieldBits; // read so far into the current field
+    U32 mFieldValue;
+    U32 mFieldStartBit;
+    U64 mFieldStartSample;
+    bool mExtended;
+    U64 mIdentifierStartSample;
+    U32 mReservedErrorBit; // 0 while the reserved bits are dominant
+    U64 mReservedErrorSample;
+    U32 mDataBytesLeft;
+    U32 mEofBits;
+    bool mXl;
+    bool mXlDataPhase; // between the ADH and DAH bits, where the bit rate is the data bit rate
+    U32 mFixedStuffCount;
+    U64 mXlFieldStartSample; // where the SDT or the VCID started
+    U32 mXlSdt;
+    U32 mXlSec;
+    U32 mXlDlc;
+    U32 mXlVcid;
+
+    std::vector<CanMarker> mCanMarkers;
+
+    bool mRemoteFrame;
+    U32 mNumDataBytes;
+
+    U32 mNumRawBits;
+    bool mErrorFlag;
+    bool mCanError;
+    CanErrorType mErrorType;
+    U32 mErrorBit;
+    bool mHasSuspectBit;
+    U32 mSuspectBit;
+    U64 mSuspectSample;
+    std::vector<U32> mDestuffedBits; // raw index of each destuffed bit
+    U64 mErrorStartingSample;
+    U64 mErrorEndingSample;
+};
+
+#endif // CAN_FRAME_DECODER
@@ -0,0 +1,113 @@
+#include "CanGateway.h"
+#include <cstring>
+
+CanGateway::CanGateway() : mMaxLatencySamples( 0 )
+{
+    Reset( 0 );
+}
+
+CanGateway::~CanGateway()
+{
+}
+
+void CanGateway::Reset( U32 sample_rate_hz )
+{
+    for( U32 side = 0; side < 2; side++ )
+    {
+        Window& window = mWindows[ side ];
+        for( U32 i = 0; i < GATEWAY_WINDOW_MESSAGES; i++ )
+            window.mEntries[ i ].mInUse = false;
+        for( U32 i = 0; i < GATEWAY_HASH_SLOTS; i++ )
+            window.mSlots[ i ] = -1;
+        window.mNextEntry = 0;
+    }
+
+    mMaxLatencySamples = U64( double( sample_rate_hz ) * GATEWAY_MAX_LATENCY_S );
+}
+
+bool CanGateway::ProcessMessage( GatewaySide side, const CanMessage& message, U64& latency_samples )
+{
+    U32 hash = Hash( message );
+    Window& other = mWindows[ side == GatewaySideA ? GatewaySideB : GatewaySideA ];
+
+    // the oldest identical message on the other side that is recent enough is the original.
+    S32 original = -1;
+    for( S32 index = other.mSlots[ hash & ( GATEWAY_HASH_SLOTS - 1 ) ]; index >= 0; index = other.mEntries[ index ].mNext )
+    {
+        const Entry& entry = other.mEntries[ index ];
+        if( entry.mHash != hash || IsSameMessage( entry.mMessage, message ) == false )
+            continue;
+        if( entry.mMessage.mStartingSample > message.mStartingSample ||
+            message.mStartingSample - entry.mMessage.mStartingSample > mMaxLatencySamples )
+            continue;
+        if( original < 0 || entry.mMessage.mStartingSample < other.mEntries[ original ].mMessage.mStartingSample )
+            original = index;
+    }
+
+    if( original < 0 )
+    {
+        Insert( mWindows[ side ], hash, message );
+        return false;
+    }
+
+    latency_samples = message.mStartingSample - other.mEntries[ original ].mMessage.mStartingSample;
+    Remove( other, original );
+    return true;
+}
+
+U32 CanGateway::Hash( const CanMessage& message )
+{
+    U32 key[ 2 ] = { message.mIdentifier | ( message.mExtended ? 0x80000000 : 0 ),
+                     message.mDlc | ( message.mRemoteFrame ? 0x100 : 0 ) | ( message.mNumDataBytes << 16 ) };
+
+    U32 hash = 2166136261u;
+    for( U32 i = 0; i < 2; i++ )
+    {
+        hash ^= key[ i ];
+        hash *= 16777619u;
+    }
+    return hash ^ U32( message.mPayloadHash ) ^ U32( message.mPayloadHash >> 32 );
+}
+
+bool CanGateway::IsSameMessage( const CanMessage& a, const CanMessage& b )
+{
+    // a CAN XL payload is longer than mData; the rest of it is only compared by its hash.
+    return a.mIdentifier == b.mIdentifier && a.mExtended == b.mExtended && a.mRemoteFrame == b.mRemoteFrame && a.mDlc == b.mDlc &&
+           a.mNumDataBytes == b.mNumDataBytes && memcmp( a.mData, b.mData, a.mNumDataBytes ) == 0 &&
+           a.mPayloadHash == b.mPayloadHash;
+}
+
+void CanGateway::Insert( Window& window, U32 hash, const CanMessage& message )
+{
+    // the window is a ring; the oldest unmatched message makes way for the new one.
+    S32 index = S32( window.mNextEntry++ & ( GATEWAY_WINDOW_MESSAGES - 1 ) );
+    if( window.mEntries[ index ].mInUse == true )
+        Remove( window, index );
+
+    Entry& entry = window.mEntries[ index ];
+    S32& head = window.mSlots[ hash & ( GATEWAY_HASH_SLOTS - 1 ) ];
+
+    entry.mInUse = true;
+    entry.mHash = hash;
+    entry.mMessage = message;
+    entry.mPrevious = -1;
+    entry.mNext = head;
+    if( head >= 0 )
+        window.mEntries[ head ].mPrevious = index;
+    head = index;
+}
+
+void CanGateway::Remove( Window& window, S32 index )
+{
+    Entry& entry = window.mEntries[ index ];
+
+    if( entry.mPrevious >= 0 )
+        window.mEntries[ entry.mPrevious ].mNext = entry.mNext;
+    else
+        window.mSlots[ entry.mHash & ( GATEWAY_HASH_SLOTS - 1 ) ] = entry.mNext;
+
+    if( entry.mNext >= 0 )
+        window.mEntries[ entry.mNext ].mPrevious = entry.mPrevious;
+
+    entry.mInUse = false;
+}
@@ -0,0 +1,59 @@
+#ifndef CAN_GATEWAY
+#define CAN_GATEWAY
+
+#include "CanMessage.h"
+
+#define GATEWAY_WINDOW_MESSAGES 256 // unmatched messages remembered per side, must be a power of two
+#define GATEWAY_HASH_SLOTS 512      // must be a power of two
+#define GATEWAY_MAX_LATENCY_S 1.0
+
+enum GatewaySide
+{
+    GatewaySideA, // the analyzer's main CAN channel
+    GatewaySideB
+};
+
+// Matches messages forwarded by a gateway between two buses.
+//
+// Each side keeps a bounded window of its most recent unmatched messages, indexed by a hash of identifier, DLC and the whole payload.
+// A message is taken to be a forwarded copy when an identical message was seen on the other side within
+// GATEWAY_MAX_LATENCY_S; the oldest such message is consumed, so repeated identical messages pair up in order.
+class CanGateway
+{
+  public:
+    CanGateway();
+    ~CanGateway();
+
+    void Reset( U32 sample_rate_hz );
+
+    // messages must be passed in order of their starting samples, whichever side they are on. returns true when message is a
+    // forwarded copy, with the time between the starts of the two messages.
+    bool ProcessMessage( GatewaySide side, const CanMessage& message, U64& latency_samples );
+
+  protected:
+    struct Entry
+    {
+        bool mInUse;
+        U32 mHash;
+        CanMessage mMessage;
+        S32 mPrevious; // hash slot list links, -1 at either end
+        S32 mNext;
+    };
+
+    struct Window
+    {
+        Entry mEntries[ GATEWAY_WINDOW_MESSAGES ];
+        S32 mSlots[ GATEWAY_HASH_SLOTS ];
+        U32 mNextEntry;
+    };
+
+    U32 Hash( const CanMessage& message );
+    bool IsSameMessage( const CanMessage& a, const CanMessage& b );
+    void Insert( Window& window, U32 hash, const CanMessage& message );
+    void Remove( Window& window, S32 index );
+
+    Window mWindows[ 2 ];
+    U64 mMaxLatencySamples;
+};
+
+#endif // CAN_GATEWAY
@@ -0,0 +1,378 @@
+#include "CanIsoTp.h"
+#include <cstring>
+
+namespace
+{
+    const U32 gExtendedKeyFlag = 0x80000000;
+    const U32 gIdentifierMask = 0x1FFFFFFF;
+
+    enum ProtocolControlInformation
+    {
+        SingleFrame = 0,
+        FirstFrame = 1,
+        ConsecutiveFrame = 2,
+        FlowControl = 3
+    };
+
+    enum FlowStatus
+    {
+        ContinueToSend = 0,
+        Wait = 1,
+        Overflow = 2
+    };
+
+    U32 MessageKey( const CanMessage& message )
+    {
+        return message.mIdentifier | ( message.mExtended ? gExtendedKeyFlag : 0 );
+    }
+}
+
+CanIsoTp::CanIsoTp() : mSampleRateHz( 0 ), mFlowControlTimeoutSamples( 0 ), mConsecutiveTimeoutSamples( 0 )
+{
+    Reset( 0 );
+}
+
+CanIsoTp::~CanIsoTp()
+{
+}
+
+void CanIsoTp::Reset( U32 sample_rate_hz )
+{
+    mSampleRateHz = sample_rate_hz;
+    mFlowControlTimeoutSamples = U64( double( sample_rate_hz ) * ISOTP_N_BS_TIMEOUT_S );
+    mConsecutiveTimeoutSamples = U64( double( sample_rate_hz ) * ISOTP_N_CR_TIMEOUT_S );
+
+    for( U32 i = 0; i < ISOTP_NUM_SESSIONS; i++ )
+    {
+        mSessions[ i ].mInUse = false;
+        mSessions[ i ].mState = Idle;
+        mSessions[ i ].mBuffer = -1;
+        mSessions[ i ].mPacketIds.clear();
+    }
+
+    mBufferPool.resize( ISOTP_NUM_BUFFERS * ISOTP_MAX_PDU_LENGTH );
+    mFreeBuffers.clear();
+    for( S32 i = ISOTP_NUM_BUFFERS - 1; i >= 0; i-- )
+        mFreeBuffers.push_back( i );
+}
+
+void CanIsoTp::ProcessMessage( const CanMessage& message, U64 packet_id, std::vector<IsoTpEvent>& events )
+{
+    if( message.mRemoteFrame == true || message.mNumDataBytes == 0 )
+        return;
+
+    const U8* data = message.mData;
+    U32 key = MessageKey( message );
+
+    switch( data[ 0 ] >> 4 )
+    {
+    case SingleFrame:
+    {
+        U32 length = data[ 0 ] & 0xF;
+        if( length == 0 || length >= message.mNumDataBytes )
+            return;
+
+        Session* session = FindSession( key, false );
+        if( session != NULL && session->mState != Idle )
+        {
+            AddEvent( events, IsoTpError, *session, "single frame interrupted a multi-frame transfer" );
+            EndSession( *session );
+        }
+
+        mSinglePacket.assign( 1, packet_id );
+
+        IsoTpEvent event;
+        event.mType = IsoTpPduComplete;
+        event.mSourceId = message.mIdentifier;
+        event.mTargetId = ( session != NULL && session->mPartnerKnown ) ? ( session->mPartnerKey & gIdentifierMask ) : ISOTP_UNKNOWN_ID;
+        event.mData = data + 1;
+        event.mLength = length;
+        event.mPacketIds = &mSinglePacket;
+        event.mReason = "";
+        events.push_back( event );
+    }
+    break;
+    case FirstFrame:
+    {
+        U32 length = ( U32( data[ 0 ] & 0xF ) << 8 ) | data[ 1 ];
+        if( message.mNumDataBytes != 8 || length < 8 )
+            return;
+
+        Session* session = FindSession( key, true );
+        if( session == NULL )
+            return; // table full; the transfer is not tracked.
+
+        if( session->mState != Idle )
+        {
+            AddEvent( events, IsoTpError, *session, "first frame interrupted a multi-frame transfer" );
+            EndSession( *session );
+        }
+
+        session->mBuffer = AllocateBuffer( events );
+        if( session->mBuffer < 0 )
+            return;
+
+        memcpy( &mBufferPool[ session->mBuffer * ISOTP_MAX_PDU_LENGTH ], data + 2, 6 );
+        session->mState = WaitFlowControl;
+        session->mLength = length;
+        session->mReceived = 6;
+        session->mNextSequence = 1;
+        session->mBlockSize = 0;
+        session->mBlockCount = 0;
+        session->mSeparationSamples = 0;
+        session->mStartingSample = message.mStartingSample;
+        session->mLastSample = message.mEndingSample;
+        session->mLastConsecutiveSample = message.mEndingSample;
+        session->mPacketIds.assign( 1, packet_id );
+    }
+    break;
+    case ConsecutiveFrame:
+    {
+        Session* session = FindSession( key, false );
+        if( session == NULL || session->mState == Idle )
+            return; // not part of a transfer we saw start.
+
+        session->mPacketIds.push_back( packet_id );
+
+        if( ( data[ 0 ] & 0xF ) != session->mNextSequence )
+        {
+            AddEvent( events, IsoTpError, *session, "wrong sequence number" );
+            EndSession( *session );
+            return;
+        }
+
+        if( message.mStartingSample - session->mLastSample > mConsecutiveTimeoutSamples )
+        {
+            AddEvent( events, IsoTpError, *session, "N_Cr timeout" );
+            EndSession( *session );
+            return;
+        }
+
+        if( session->mState == WaitFlowControl )
+            AddEvent( events, IsoTpError, *session, "consecutive frame without flow control" );
+        else if( message.mStartingSample - session->mLastConsecutiveSample < session->mSeparationSamples )
+            AddEvent( events, IsoTpError, *session, "STmin violated" );
+
+        U32 count = session->mLength - session->mReceived;
+        if( count > message.mNumDataBytes - 1 )
+            count = message.mNumDataBytes - 1;
+
+        memcpy( &mBufferPool[ session->mBuffer * ISOTP_MAX_PDU_LENGTH + session->mReceived ], data + 1, count );
+        session->mReceived += count;
+        session->mNextSequence = ( session->mNextSequence + 1 ) & 0xF;
+        session->mLastSample = message.mEndingSample;
+        session->mLastConsecutiveSample = message.mStartingSample;
+        session->mState = Receiving;
+
+        if( session->mReceived == session->mLength )
+        {
+            AddEvent( events, IsoTpPduComplete, *session, "" );
+            EndSession( *session );
+        }
+        else if( session->mBlockSize != 0 && ++session->mBlockCount == session->mBlockSize )
+        {
+            session->mBlockCount = 0;
+            session->mState = WaitFlowControl;
+        }
+    }
+    break;
+    case FlowControl:
+    {
+        if( message.mNumDataBytes < 3 )
+            return;
+
+        Session* session = FindFlowControlTarget( key );
+        if( session == NULL )
+            return;
+
+        session->mPartnerKey = key;
+        session->mPartnerKnown = true;
+        session->mPacketIds.push_back( packet_id );
+
+        if( message.mStartingSample - session->mLastSample > mFlowControlTimeoutSamples )
+        {
+            AddEvent( events, IsoTpError, *session, "N_Bs timeout" );
+            EndSession( *session );
+            return;
+        }
+
+        session->mLastSample = message.mEndingSample;
+
+        switch( data[ 0 ] & 0xF )
+        {
+        case ContinueToSend:
+            session->mState = Receiving;
+            session->mBlockSize = data[ 1 ];
+            session->mBlockCount = 0;
+            session->mSeparationSamples = SeparationTimeToSamples( data[ 2 ] );
+            session->mLastConsecutiveSample = 0; // STmin only applies between consecutive frames.
+            break;
+        case Wait:
+            break;
+        case Overflow:
+            AddEvent( events, IsoTpError, *session, "receiver overflow" );
+            EndSession( *session );
+            break;
+        default:
+            AddEvent( events, IsoTpError, *session, "invalid flow status" );
+            EndSession( *session );
+            break;
+        }
+    }
+    break;
+    }
+}
+
+CanIsoTp::Session* CanIsoTp::FindSession( U32 key, bool create )
+{
+    U32 index = ( key * 2654435761u ) & ( ISOTP_NUM_SESSIONS - 1 );
+
+    for( U32 i = 0; i < ISOTP_NUM_SESSIONS; i++ )
+    {
+        Session& session = mSessions[ ( index + i ) & ( ISOTP_NUM_SESSIONS - 1 ) ];
+
+        if( session.mInUse == false )
+        {
+            if( create == false )
+                return NULL;
+
+            session.mInUse = true;
+            session.mKey = key;
+            session.mPartnerKnown = false;
+            session.mState = Idle;
+            session.mBuffer = -1;
+            return &session;
+        }
+
+        if( session.mKey == key )
+            return &session;
+    }
+
+    if( create == false )
+        return NULL;
+
+    // the table is full, and stays full, so no probe sequence ever ends early and a session can be replaced in place. only
+    // transfers in progress hold a buffer, and there are fewer buffers than sessions, so there is always an idle one to reuse;
+    // take the one that has been quiet the longest.
+    Session* stalest = NULL;
+    for( U32 i = 0; i < ISOTP_NUM_SESSIONS; i++ )
+    {
+        Session& session = mSessions[ i ];
+        if( session.mState == Idle && ( stalest == NULL || session.mLastSample < stalest->mLastSample ) )
+            stalest = &session;
+    }
+
+    if( stalest == NULL )
+        return NULL;
+
+    stalest->mKey = key;
+    stalest->mPartnerKnown = false;
+    stalest->mBuffer = -1;
+    return stalest;
+}
+
+CanIsoTp::Session* CanIsoTp::FindFlowControlTarget( U32 key )
+{
+    // flow control frames are rare, so a scan of the table is fine here.
+    Session* unpaired = NULL;
+
+    for( U32 i = 0; i < ISOTP_NUM_SESSIONS; i++ )
+    {
+        Session& session = mSessions[ i ];
+        if( session.mInUse == false || session.mState == Idle || session.mKey == key )
+            continue;
+
+        if( session.mPartnerKnown == true )
+        {
+            if( session.mPartnerKey == key )
+                return &session;
+            continue;
+        }
+
+        // normal fixed addressing (29-bit 0x18DA<TA><SA>): the flow control comes back with the addresses swapped.
+        if( ( key & gExtendedKeyFlag ) != 0 && ( key & 0x1FFF0000 ) == 0x18DA0000 )
+        {
+            U32 swapped = ( key & 0xFFFF0000 ) | ( ( key & 0xFF ) << 8 ) | ( ( key >> 8 ) & 0xFF );
+            if( session.mKey == swapped )
+                return &session;
+            continue;
+        }
+
+        // otherwise pair with the longest waiting transfer that has no partner yet.
+        if( session.mState == WaitFlowControl && ( unpaired == NULL || session.mStartingSample < unpaired->mStartingSample ) )
+            unpaired = &session;
+    }
+
+    return unpaired;
+}
+
+S32 CanIsoTp::AllocateBuffer( std::vector<IsoTpEvent>& events )
+{
+    if( mFreeBuffers.empty() == true )
+    {
+        // every buffer is taken; give up on the transfer that has been silent the longest.
+        Session* stalest = NULL;
+        for( U32 i = 0; i < ISOTP_NUM_SESSIONS; i++ )
+        {
+            Session& session = mSessions[ i ];
+            if( session.mInUse == true && session.mBuffer >= 0 && ( stalest == NULL || session.mLastSample < stalest->mLastSample ) )
+                stalest = &session;
+        }
+
+        if( stalest == NULL )
+            return -1;
+
+        AddEvent( events, IsoTpError, *stalest, "transfer abandoned" );
+        EndSession( *stalest );
+    }
+
+    S32 buffer = mFreeBuffers.back();
+    mFreeBuffers.pop_back();
+    return buffer;
+}
+
+void CanIsoTp::EndSession( Session& session )
+{
+    if( session.mBuffer >= 0 )
+        mFreeBuffers.push_back( session.mBuffer );
+
+    session.mBuffer = -1;
+    session.mState = Idle;
+}
+
+void CanIsoTp::AddEvent( std::vector<IsoTpEvent>& events, IsoTpEventType type, Session& session, const char* reason )
+{
+    IsoTpEvent event;
+    event.mType = type;
+    event.mSourceId = session.mKey & gIdentifierMask;
+    event.mTargetId = session.mPartnerKnown ? ( session.mPartnerKey & gIdentifierMask ) : ISOTP_UNKNOWN_ID;
+    event.mLength = session.mReceived;
+    event.mReason = reason;
+
+    // errors don't carry the payload; the session may be restarted before the caller looks at the event.
+    if( type == IsoTpPduComplete )
+    {
+        event.mData = &mBufferPool[ session.mBuffer * ISOTP_MAX_PDU_LENGTH ];
+        event.mPacketIds = &session.mPacketIds;
+    }
+    else
+    {
+        event.mData = NULL;
+        event.mPacketIds = NULL;
+    }
+
+    events.push_back( event );
+}
+
+U64 CanIsoTp::SeparationTimeToSamples( U8 st_min )
+{
+    double seconds;
+    if( st_min <= 0x7F )
+        seconds = double( st_min ) * 1e-3;
+    else if( st_min >= 0xF1 && st_min <= 0xF9 )
+        seconds = double( st_min - 0xF0 ) * 100e-6;
+    else
+        seconds = 127e-3; // reserved values are to be treated as the maximum.
+
+    return U64( seconds * double( mSampleRateHz ) );
+}
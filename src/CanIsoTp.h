@@ -0,0 +1,93 @@
+#ifndef CAN_ISO_TP
+#define CAN_ISO_TP
+
+#include "CanMessage.h"
+#include <vector>
+
+#define ISOTP_MAX_PDU_LENGTH 4095
+#define ISOTP_NUM_SESSIONS 64 // flat session table, must be a power of two
+#define ISOTP_NUM_BUFFERS 32  // reassembly buffers shared by all sessions, fewer than ISOTP_NUM_SESSIONS
+#define ISOTP_N_BS_TIMEOUT_S 1.0
+#define ISOTP_N_CR_TIMEOUT_S 1.0
+#define ISOTP_UNKNOWN_ID 0xFFFFFFFF
+
+enum IsoTpEventType
+{
+    IsoTpPduComplete,
+    IsoTpError
+};
+
+// valid until the next call to CanIsoTp::ProcessMessage.
+struct IsoTpEvent
+{
+    IsoTpEventType mType;
+    U32 mSourceId;
+    U32 mTargetId; // ISOTP_UNKNOWN_ID until a flow control frame pairs the session.
+    const U8* mData;
+    U32 mLength;
+    const std::vector<U64>* mPacketIds;
+    const char* mReason;
+};
+
+// Streaming ISO 15765-2 reassembly (normal addressing, classic CAN) over decoded messages.
+//
+// Sessions are keyed by the sending identifier in a flat open-addressed table and paired with the identifier that sends
+// their flow control frames. Once the table is full, a new identifier takes over the idle session that has been quiet the
+// longest. Multi-frame payloads are reassembled into a fixed pool of buffers, so memory use is bounded no
+// matter how many transfers are in flight. Flow control (N_Bs), consecutive frame (N_Cr) and STmin timing is checked as the
+// frames arrive.
+class CanIsoTp
+{
+  public:
+    CanIsoTp();
+    ~CanIsoTp();
+
+    void Reset( U32 sample_rate_hz );
+    void ProcessMessage( const CanMessage& message, U64 packet_id, std::vector<IsoTpEvent>& events );
+
+  protected:
+    enum SessionState
+    {
+        Idle,
+        WaitFlowControl,
+        Receiving
+    };
+
+    struct Session
+    {
+        bool mInUse;
+        U32 mKey;
+        U32 mPartnerKey;
+        bool mPartnerKnown;
+        SessionState mState;
+        U32 mLength;
+        U32 mReceived;
+        U8 mNextSequence;
+        S32 mBuffer;
+        U32 mBlockSize;
+        U32 mBlockCount;
+        U64 mSeparationSamples;
+        U64 mLastSample;
+        U64 mLastConsecutiveSample;
+        U64 mStartingSample;
+        std::vector<U64> mPacketIds;
+    };
+
+    Session* FindSession( U32 key, bool create );
+    Session* FindFlowControlTarget( U32 key );
+    S32 AllocateBuffer( std::vector<IsoTpEvent>& events );
+    void EndSession( Session& session );
+    void AddEvent( std::vector<IsoTpEvent>& events, IsoTpEventType type, Session& session, const char* reason );
+    U64 SeparationTimeToSamples( U8 st_min );
+
+    Session mSessions[ ISOTP_NUM_SESSIONS ];
+    std::vector<U8> mBufferPool;
+    std::vector<S32> mFreeBuffers;
+    std::vector<U64> mSinglePacket;
+
+    U32 mSampleRateHz;
+    U64 mFlowControlTimeoutSamples;
+    U64 mConsecutiveTimeoutSamples;
+};
+
+#endif // CAN_ISO_TP
@@ -0,0 +1,267 @@
+#include "CanJ1939.h"
+#include <cstring>
+
+namespace
+{
+    const U32 gPgnTransportConnection = 0xEC00; // TP.CM
+    const U32 gPgnTransportData = 0xEB00;       // TP.DT
+
+    enum ConnectionControl
+    {
+        RequestToSend = 16,
+        ClearToSend = 17,
+        EndOfMessageAck = 19,
+        BroadcastAnnounce = 32,
+        ConnectionAbort = 255
+    };
+
+    struct PgnName
+    {
+        U32 mPgn;
+        const char* mName;
+    };
+
+    // sorted by PGN for binary search.
+    const PgnName gPgnNames[] = {
+        { 0x0000, "TSC1" },  { 0xE800, "ACKM" },  { 0xEA00, "RQST" },  { 0xEB00, "TP.DT" }, { 0xEC00, "TP.CM" },
+        { 0xEE00, "AC" },    { 0xF001, "EBC1" },  { 0xF002, "ETC1" },  { 0xF003, "EEC2" },  { 0xF004, "EEC1" },
+        { 0xFEBF, "EBC2" },  { 0xFECA, "DM1" },   { 0xFECB, "DM2" },   { 0xFECE, "DM5" },   { 0xFEDA, "SOFT" },
+        { 0xFEE0, "VD" },    { 0xFEE5, "HOURS" }, { 0xFEE6, "TD" },    { 0xFEE9, "LFC1" },  { 0xFEEC, "VI" },
+        { 0xFEEE, "ET1" },   { 0xFEEF, "EFL/P1" }, { 0xFEF1, "CCVS1" }, { 0xFEF2, "LFE1" },  { 0xFEF5, "AMB" },
+        { 0xFEF6, "IC1" },   { 0xFEF7, "VEP1" },  { 0xFEFC, "DD" },
+    };
+
+    U32 ReadPgn( const U8* data )
+    {
+        return U32( data[ 0 ] ) | ( U32( data[ 1 ] ) << 8 ) | ( U32( data[ 2 ] ) << 16 );
+    }
+}
+
+J1939Identifier J1939SplitIdentifier( U32 identifier )
+{
+    J1939Identifier id;
+    U32 data_page = ( identifier >> 24 ) & 0x3; // EDP and DP
+    U32 pdu_format = ( identifier >> 16 ) & 0xFF;
+    U32 pdu_specific = ( identifier >> 8 ) & 0xFF;
+
+    id.mPriority = U8( ( identifier >> 26 ) & 0x7 );
+    id.mSourceAddress = U8( identifier & 0xFF );
+
+    // PDU1 (PF < 240) carries a destination address in PS; PDU2 uses PS as the group extension of a broadcast PGN.
+    if( pdu_format < 240 )
+    {
+        id.mPgn = ( data_page << 16 ) | ( pdu_format << 8 );
+        id.mDestinationAddress = U8( pdu_specific );
+    }
+    else
+    {
+        id.mPgn = ( data_page << 16 ) | ( pdu_format << 8 ) | pdu_specific;
+        id.mDestinationAddress = J1939_GLOBAL_ADDRESS;
+    }
+
+    return id;
+}
+
+const char* J1939PgnName( U32 pgn )
+{
+    U32 low = 0;
+    U32 high = sizeof( gPgnNames ) / sizeof( gPgnNames[ 0 ] );
+
+    while( low < high )
+    {
+        U32 mid = ( low + high ) / 2;
+        if( gPgnNames[ mid ].mPgn < pgn )
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if( low < sizeof( gPgnNames ) / sizeof( gPgnNames[ 0 ] ) && gPgnNames[ low ].mPgn == pgn )
+        return gPgnNames[ low ].mName;
+    return NULL;
+}
+
+CanJ1939::CanJ1939() : mPacketTimeoutSamples( 0 )
+{
+    Reset( 0 );
+}
+
+CanJ1939::~CanJ1939()
+{
+}
+
+void CanJ1939::Reset( U32 sample_rate_hz )
+{
+    mPacketTimeoutSamples = U64( double( sample_rate_hz ) * J1939_T1_TIMEOUT_S );
+
+    for( U32 i = 0; i < J1939_NUM_SESSIONS; i++ )
+        mSessions[ i ].mInUse = false;
+}
+
+void CanJ1939::ProcessMessage( const CanMessage& message, std::vector<J1939Event>& events )
+{
+    if( message.mExtended == false || message.mRemoteFrame == true || message.mNumDataBytes != 8 )
+        return;
+
+    J1939Identifier id = J1939SplitIdentifier( message.mIdentifier );
+
+    if( id.mPgn == gPgnTransportConnection )
+        ProcessConnectionManagement( message, id, events );
+    else if( id.mPgn == gPgnTransportData )
+        ProcessDataTransfer( message, id, events );
+}
+
+void CanJ1939::ProcessConnectionManagement( const CanMessage& message, const J1939Identifier& id, std::vector<J1939Event>& events )
+{
+    const U8* data = message.mData;
+
+    switch( data[ 0 ] )
+    {
+    case RequestToSend:
+    case BroadcastAnnounce:
+    {
+        bool broadcast = data[ 0 ] == BroadcastAnnounce;
+        U8 destination = broadcast ? U8( J1939_GLOBAL_ADDRESS ) : id.mDestinationAddress;
+
+        Session* session = StartSession( id.mSourceAddress, destination, events );
+        session->mBroadcast = broadcast;
+        session->mPgn = ReadPgn( data + 5 );
+        session->mLength = U32( data[ 1 ] ) | ( U32( data[ 2 ] ) << 8 );
+        session->mNumPackets = data[ 3 ];
+        session->mReceivedPackets = 0;
+        session->mLastSample = message.mEndingSample;
+
+        // a transfer with nothing in it could never complete.
+        if( session->mLength == 0 || session->mNumPackets == 0 || session->mLength > J1939_MAX_TRANSPORT_LENGTH ||
+            session->mNumPackets * 7 < session->mLength )
+        {
+            AddEvent( events, J1939TransferError, *session, "invalid transfer size" );
+            session->mInUse = false;
+        }
+    }
+    break;
+    case ClearToSend:
+    {
+        // CTS goes from the receiver back to the originator.
+        Session* session = FindSession( id.mDestinationAddress, id.mSourceAddress );
+        if( session != NULL )
+            session->mLastSample = message.mEndingSample;
+    }
+    break;
+    case ConnectionAbort:
+    {
+        // either side may abort.
+        Session* session = FindSession( id.mSourceAddress, id.mDestinationAddress );
+        if( session == NULL )
+            session = FindSession( id.mDestinationAddress, id.mSourceAddress );
+
+        if( session != NULL )
+        {
+            AddEvent( events, J1939TransferError, *session, "connection aborted" );
+            session->mInUse = false;
+        }
+    }
+    break;
+    case EndOfMessageAck:
+    default:
+        break;
+    }
+}
+
+void CanJ1939::ProcessDataTransfer( const CanMessage& message, const J1939Identifier& id, std::vector<J1939Event>& events )
+{
+    Session* session = FindSession( id.mSourceAddress, id.mDestinationAddress );
+    if( session == NULL )
+        return;
+
+    U32 sequence = message.mData[ 0 ];
+
+    if( message.mStartingSample - session->mLastSample > mPacketTimeoutSamples )
+    {
+        AddEvent( events, J1939TransferError, *session, "T1 timeout" );
+        session->mInUse = false;
+        return;
+    }
+
+    if( sequence == 0 || sequence > session->mNumPackets || sequence > session->mReceivedPackets + 1 )
+    {
+        AddEvent( events, J1939TransferError, *session, "wrong sequence number" );
+        session->mInUse = false;
+        return;
+    }
+
+    // a repeated packet (retransmission after CTS) simply overwrites its slot.
+    U32 offset = ( sequence - 1 ) * 7;
+    U32 count = session->mLength > offset ? session->mLength - offset : 0;
+    if( count > 7 )
+        count = 7;
+
+    memcpy( session->mData + offset, message.mData + 1, count );
+    if( sequence > session->mReceivedPackets )
+        session->mReceivedPackets = sequence;
+    session->mLastSample = message.mEndingSample;
+
+    if( session->mReceivedPackets == session->mNumPackets )
+    {
+        AddEvent( events, J1939TransferComplete, *session, "" );
+        session->mInUse = false;
+    }
+}
+
+CanJ1939::Session* CanJ1939::FindSession( U8 source_address, U8 destination_address )
+{
+    for( U32 i = 0; i < J1939_NUM_SESSIONS; i++ )
+    {
+        Session& session = mSessions[ i ];
+        if( session.mInUse == true && session.mSourceAddress == source_address && session.mDestinationAddress == destination_address )
+            return &session;
+    }
+    return NULL;
+}
+
+CanJ1939::Session* CanJ1939::StartSession( U8 source_address, U8 destination_address, std::vector<J1939Event>& events )
+{
+    // only one transfer per source/destination pair may be open; a new announcement replaces the old one.
+    Session* session = FindSession( source_address, destination_address );
+    if( session != NULL )
+    {
+        AddEvent( events, J1939TransferError, *session, "transfer interrupted" );
+    }
+    else
+    {
+        for( U32 i = 0; i < J1939_NUM_SESSIONS; i++ )
+        {
+            Session& candidate = mSessions[ i ];
+            if( candidate.mInUse == false )
+            {
+                session = &candidate;
+                break;
+            }
+
+            if( session == NULL || candidate.mLastSample < session->mLastSample )
+                session = &candidate;
+        }
+
+        if( session->mInUse == true )
+            AddEvent( events, J1939TransferError, *session, "transfer abandoned" );
+    }
+
+    session->mInUse = true;
+    session->mSourceAddress = source_address;
+    session->mDestinationAddress = destination_address;
+    return session;
+}
+
+void CanJ1939::AddEvent( std::vector<J1939Event>& events, J1939EventType type, Session& session, const char* reason )
+{
+    J1939Event event;
+    event.mType = type;
+    event.mBroadcast = session.mBroadcast;
+    event.mPgn = session.mPgn;
+    event.mSourceAddress = session.mSourceAddress;
+    event.mDestinationAddress = session.mDestinationAddress;
+    event.mData = type == J1939TransferComplete ? session.mData : NULL;
+    event.mLength = session.mLength;
+    event.mReason = reason;
+    events.push_back( event );
+}
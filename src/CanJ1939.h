@@ -0,0 +1,80 @@
+#ifndef CAN_J1939
+#define CAN_J1939
+
+#include "CanMessage.h"
+#include <vector>
+
+#define J1939_MAX_TRANSPORT_LENGTH 1785 // 255 packets of 7 bytes
+#define J1939_NUM_SESSIONS 32           // concurrent BAM / CMDT transfers tracked
+#define J1939_T1_TIMEOUT_S 0.75         // maximum gap between data transfer packets
+#define J1939_GLOBAL_ADDRESS 0xFF
+
+struct J1939Identifier
+{
+    U8 mPriority;
+    U32 mPgn;
+    U8 mSourceAddress;
+    U8 mDestinationAddress; // J1939_GLOBAL_ADDRESS for PDU2 (broadcast) PGNs
+};
+
+J1939Identifier J1939SplitIdentifier( U32 identifier );
+const char* J1939PgnName( U32 pgn ); // NULL when the PGN is not in the table
+
+enum J1939EventType
+{
+    J1939TransferComplete,
+    J1939TransferError
+};
+
+// valid until the next call to CanJ1939::ProcessMessage.
+struct J1939Event
+{
+    J1939EventType mType;
+    bool mBroadcast; // BAM rather than RTS/CTS
+    U32 mPgn;
+    U8 mSourceAddress;
+    U8 mDestinationAddress;
+    const U8* mData;
+    U32 mLength;
+    const char* mReason;
+};
+
+// J1939-21 transport protocol reassembly (TP.BAM and TP.CM RTS/CTS with TP.DT) over decoded messages.
+//
+// Transfers are tracked in a fixed table of sessions keyed by source and destination address, each with its own payload
+// buffer, so memory stays bounded; when the table is full the oldest transfer is dropped.
+class CanJ1939
+{
+  public:
+    CanJ1939();
+    ~CanJ1939();
+
+    void Reset( U32 sample_rate_hz );
+    void ProcessMessage( const CanMessage& message, std::vector<J1939Event>& events );
+
+  protected:
+    struct Session
+    {
+        bool mInUse;
+        bool mBroadcast;
+        U8 mSourceAddress;
+        U8 mDestinationAddress;
+        U32 mPgn;
+        U32 mLength;
+        U32 mNumPackets;
+        U32 mReceivedPackets;
+        U64 mLastSample;
+        U8 mData[ J1939_MAX_TRANSPORT_LENGTH ];
+    };
+
+    void ProcessConnectionManagement( const CanMessage& message, const J1939Identifier& id, std::vector<J1939Event>& events );
+    void ProcessDataTransfer( const CanMessage& message, const J1939Identifier& id, std::vector<J1939Event>& events );
+    Session* FindSession( U8 source_address, U8 destination_address );
+    Session* StartSession( U8 source_address, U8 destination_address, std::vector<J1939Event>& events );
+    void AddEvent( std::vector<J1939Event>& events, J1939EventType type, Session& session, const char* reason );
+
+    Session mSessions[ J1939_NUM_SESSIONS ];
+    U64 mPacketTimeoutSamples;
+};
+
+#endif // CAN_J1939
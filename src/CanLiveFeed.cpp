@@ -0,0 +1,117 @@
+#include "CanLiveFeed.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CanLiveFeed::CanLiveFeed() : mHeader( NULL ), mSlots( NULL ), mMappingSize( 0 ), mSequence( 0 )
+{
+}
+
+CanLiveFeed::~CanLiveFeed()
+{
+    Close();
+}
+
+bool CanLiveFeed::IsOpen() const
+{
+    return mHeader != NULL;
+}
+
+#ifndef _WIN32
+bool CanLiveFeed::Open( const std::string& name, U32 sample_rate_hz )
+{
+    Close();
+
+    int fd = shm_open( name.c_str(), O_RDWR | O_CREAT, 0644 );
+    if( fd < 0 )
+        return false;
+
+    U64 size = sizeof( CanLiveFeedHeader ) + U64( sizeof( CanLiveFeedSlot ) ) * CAN_LIVE_FEED_SLOTS;
+    if( ftruncate( fd, off_t( size ) ) != 0 )
+    {
+        close( fd );
+        return false;
+    }
+
+    void* mapping = mmap( NULL, size_t( size ), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close( fd );
+    if( mapping == MAP_FAILED )
+        return false;
+
+    mHeader = ( CanLiveFeedHeader* )mapping;
+    mSlots = ( CanLiveFeedSlot* )( mHeader + 1 );
+    mMappingSize = size;
+
+    // a feed with the same layout is continued; anything else is started over. a new segment is all zeroes.
+    bool same_layout = mHeader->mMagic == CAN_LIVE_FEED_MAGIC && mHeader->mVersion == CAN_LIVE_FEED_VERSION &&
+                       mHeader->mSlotSize == sizeof( CanLiveFeedSlot ) && mHeader->mNumSlots == CAN_LIVE_FEED_SLOTS;
+    if( same_layout == false )
+    {
+        mHeader->mMagic = 0; // readers ignore the segment until it's set up
+        std::atomic_thread_fence( std::memory_order_release );
+
+        for( U32 i = 0; i < CAN_LIVE_FEED_SLOTS; i++ )
+            mSlots[ i ].mSequence.store( 0, std::memory_order_relaxed );
+        mHeader->mWriteSequence.store( 0, std::memory_order_relaxed );
+        mHeader->mVersion = CAN_LIVE_FEED_VERSION;
+        mHeader->mSlotSize = sizeof( CanLiveFeedSlot );
+        mHeader->mNumSlots = CAN_LIVE_FEED_SLOTS;
+        std::atomic_thread_fence( std::memory_order_release );
+        mHeader->mMagic = CAN_LIVE_FEED_MAGIC;
+    }
+
+    mHeader->mSampleRateHz = sample_rate_hz;
+    mSequence = mHeader->mWriteSequence.load( std::memory_order_relaxed );
+    return true;
+}
+
+void CanLiveFeed::Close()
+{
+    if( mHeader == NULL )
+        return;
+
+    // the segment stays, so readers can drain it; the name is removed by whoever no longer needs it.
+    munmap( mHeader, size_t( mMappingSize ) );
+    mHeader = NULL;
+    mSlots = NULL;
+}
+#else
+bool CanLiveFeed::Open( const std::string& /*name*/, U32 /*sample_rate_hz*/ )
+{
+    return false;
+}
+
+void CanLiveFeed::Close()
+{
+}
+#endif
+
+void CanLiveFeed::Publish( const CanMessage& message )
+{
+    if( mHeader == NULL )
+        return;
+
+    mSequence++;
+    CanLiveFeedSlot& slot = mSlots[ ( mSequence - 1 ) & ( CAN_LIVE_FEED_SLOTS - 1 ) ];
+
+    // a reader copying the slot meanwhile sees the sequence number change, and drops the copy.
+    slot.mSequence.store( 0, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+
+    CanLiveFeedFrame& frame = slot.mFrame;
+    frame.mStartingSample = message.mStartingSample;
+    frame.mEndingSample = message.mEndingSample;
+    frame.mIdentifier = message.mIdentifier;
+    frame.mDlc = U16( message.mDlc );
+    frame.mFlags = ( message.mExtended ? CAN_LIVE_FEED_EXTENDED : 0 ) | ( message.mRemoteFrame ? CAN_LIVE_FEED_REMOTE : 0 );
+    frame.mNumDataBytes = U8( message.mNumDataBytes );
+    for( U32 i = 0; i < message.mNumDataBytes; i++ )
+        frame.mData[ i ] = message.mData[ i ];
+
+    slot.mSequence.store( mSequence, std::memory_order_release );
+    mHeader->mWriteSequence.store( mSequence, std::memory_order_release );
+}
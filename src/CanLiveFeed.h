@@ -0,0 +1,34 @@
+#ifndef CAN_LIVE_FEED
+#define CAN_LIVE_FEED
+
+#include <AnalyzerTypes.h>
+#include "CanLiveFeedFormat.h"
+#include "CanMessage.h"
+#include <string>
+
+// Publishes decoded messages to a POSIX shared memory segment, for local programs that follow a live capture.
+//
+// The segment is a single producer ring of fixed size slots (see CanLiveFeedFormat.h); the analyzer never waits for readers,
+// and readers that fall behind by more than the ring see a gap in the sequence numbers. Not available on Windows.
+class CanLiveFeed
+{
+  public:
+    CanLiveFeed();
+    ~CanLiveFeed();
+
+    // name is a shm_open name, like "/can_live". a feed already in the segment is continued, so attached readers see a rerun of
+    // the analyzer as more frames. returns false, and publishes nothing, when the segment can't be mapped.
+    bool Open( const std::string& name, U32 sample_rate_hz );
+    void Close();
+    bool IsOpen() const;
+
+    void Publish( const CanMessage& message );
+
+  protected:
+    CanLiveFeedHeader* mHeader; // NULL when closed
+    CanLiveFeedSlot* mSlots;
+    U64 mMappingSize;
+    U64 mSequence; // the last sequence number published
+};
+
+#endif // CAN_LIVE_FEED
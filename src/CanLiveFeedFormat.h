@@ -0,0 +1,53 @@
+#ifndef CAN_LIVE_FEED_FORMAT
+#define CAN_LIVE_FEED_FORMAT
+
+#include <atomic>
+#include <cstdint>
+
+// the layout of the live feed shared memory segment, shared by the analyzer (the only writer) and CanLiveFeedReader. it uses
+// <cstdint> types so readers can be built without the analyzer SDK.
+
+#define CAN_LIVE_FEED_MAGIC 0x4643464C // "LFCF"
+#define CAN_LIVE_FEED_VERSION 1
+#define CAN_LIVE_FEED_SLOTS 65536 // a power of two; about 2.5 MB of frames
+
+// CanLiveFeedFrame::mFlags
+#define CAN_LIVE_FEED_EXTENDED ( 1 << 0 )
+#define CAN_LIVE_FEED_REMOTE ( 1 << 1 )
+
+// one complete data or remote frame.
+struct CanLiveFeedFrame
+{
+    uint64_t mStartingSample;
+    uint64_t mEndingSample;
+    uint32_t mIdentifier;
+    uint16_t mDlc;
+    uint8_t mFlags;
+    uint8_t mNumDataBytes; // at most 8; longer CAN XL payloads are cut short
+    uint8_t mData[ 8 ];
+};
+
+// a slot holds a frame and its sequence number. the writer zeroes the sequence number while it rewrites the frame, so a reader
+// that sees the same number before and after copying the frame knows the copy is whole.
+struct CanLiveFeedSlot
+{
+    std::atomic<uint64_t> mSequence;
+    CanLiveFeedFrame mFrame;
+};
+
+// the segment starts with this header, followed by mNumSlots slots. the frame with sequence number n (counted from 1) is in slot
+// ( n - 1 ) % mNumSlots, until the writer gets mNumSlots frames ahead of it.
+struct CanLiveFeedHeader
+{
+    uint32_t mMagic;
+    uint32_t mVersion;
+    uint32_t mSlotSize;
+    uint32_t mNumSlots;
+    uint32_t mSampleRateHz; // of the capture the sample numbers are counted in
+    uint32_t mReserved[ 11 ];
+
+    std::atomic<uint64_t> mWriteSequence; // the last sequence number published, 0 before the first; on its own cache line
+    uint64_t mPadding[ 7 ];
+};
+
+#endif // CAN_LIVE_FEED_FORMAT
@@ -0,0 +1,119 @@
+#include "CanLiveFeedReader.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+CanLiveFeedReader::CanLiveFeedReader() : mHeader( NULL ), mSlots( NULL ), mMappingSize( 0 ), mNextSequence( 1 ), mNumMissedFrames( 0 )
+{
+}
+
+CanLiveFeedReader::~CanLiveFeedReader()
+{
+    Close();
+}
+
+bool CanLiveFeedReader::Open( const std::string& name )
+{
+    Close();
+
+    int fd = shm_open( name.c_str(), O_RDONLY, 0 );
+    if( fd < 0 )
+        return false;
+
+    struct stat info;
+    if( fstat( fd, &info ) != 0 || uint64_t( info.st_size ) < sizeof( CanLiveFeedHeader ) )
+    {
+        close( fd );
+        return false;
+    }
+
+    void* mapping = mmap( NULL, size_t( info.st_size ), PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if( mapping == MAP_FAILED )
+        return false;
+
+    const CanLiveFeedHeader* header = ( const CanLiveFeedHeader* )mapping;
+    uint64_t size = sizeof( CanLiveFeedHeader ) + uint64_t( header->mSlotSize ) * header->mNumSlots;
+    bool valid = header->mMagic == CAN_LIVE_FEED_MAGIC && header->mVersion == CAN_LIVE_FEED_VERSION &&
+                 header->mSlotSize == sizeof( CanLiveFeedSlot ) && header->mNumSlots != 0 &&
+                 ( header->mNumSlots & ( header->mNumSlots - 1 ) ) == 0 && size <= uint64_t( info.st_size );
+    if( valid == false )
+    {
+        munmap( mapping, size_t( info.st_size ) );
+        return false;
+    }
+
+    mHeader = header;
+    mSlots = ( const CanLiveFeedSlot* )( header + 1 );
+    mMappingSize = uint64_t( info.st_size );
+    mNextSequence = mHeader->mWriteSequence.load( std::memory_order_acquire ) + 1;
+    mNumMissedFrames = 0;
+    return true;
+}
+
+void CanLiveFeedReader::Close()
+{
+    if( mHeader == NULL )
+        return;
+
+    munmap( ( void* )mHeader, size_t( mMappingSize ) );
+    mHeader = NULL;
+    mSlots = NULL;
+}
+
+void CanLiveFeedReader::SeekToOldest()
+{
+    if( mHeader == NULL )
+        return;
+
+    uint64_t last = mHeader->mWriteSequence.load( std::memory_order_acquire );
+    mNextSequence = last >= mHeader->mNumSlots ? last - mHeader->mNumSlots + 1 : 1;
+}
+
+bool CanLiveFeedReader::Read( uint64_t& sequence, CanLiveFeedFrame& frame )
+{
+    if( mHeader == NULL )
+        return false;
+
+    for( ;; )
+    {
+        uint64_t last = mHeader->mWriteSequence.load( std::memory_order_acquire );
+        if( mNextSequence > last )
+            return false;
+
+        // the writer has lapped us; skip to the oldest frame it hasn't overwritten.
+        if( last - mNextSequence >= mHeader->mNumSlots )
+        {
+            uint64_t oldest = last - mHeader->mNumSlots + 1;
+            mNumMissedFrames += oldest - mNextSequence;
+            mNextSequence = oldest;
+        }
+
+        const CanLiveFeedSlot& slot = mSlots[ ( mNextSequence - 1 ) & ( mHeader->mNumSlots - 1 ) ];
+        uint64_t before = slot.mSequence.load( std::memory_order_acquire );
+        frame = slot.mFrame;
+        std::atomic_thread_fence( std::memory_order_acquire );
+        uint64_t after = slot.mSequence.load( std::memory_order_relaxed );
+
+        if( before == mNextSequence && after == mNextSequence )
+        {
+            sequence = mNextSequence++;
+            return true;
+        }
+
+        // the frame was overwritten while we copied it.
+        mNumMissedFrames++;
+        mNextSequence++;
+    }
+}
+
+uint64_t CanLiveFeedReader::GetNumMissedFrames() const
+{
+    return mNumMissedFrames;
+}
+
+uint32_t CanLiveFeedReader::GetSampleRateHz() const
+{
+    return mHeader != NULL ? mHeader->mSampleRateHz : 0;
+}
@@ -0,0 +1,44 @@
+#ifndef CAN_LIVE_FEED_READER
+#define CAN_LIVE_FEED_READER
+
+#include "CanLiveFeedFormat.h"
+#include <string>
+
+// Follows the live feed an analyzer publishes with the "Live feed shared memory name" setting. POSIX only.
+//
+// Any number of readers can follow one feed; they only read the segment, so the analyzer never waits for them. Frames come out
+// in order, each with its sequence number. A reader that falls more than CAN_LIVE_FEED_SLOTS frames behind skips ahead to the
+// oldest frame still in the ring, and counts the frames it missed.
+//
+//     CanLiveFeedReader reader;
+//     if( reader.Open( "/can_live" ) )
+//         for( ;; )
+//             while( reader.Read( sequence, frame ) )
+//                 ...
+class CanLiveFeedReader
+{
+  public:
+    CanLiveFeedReader();
+    ~CanLiveFeedReader();
+
+    // returns false when the segment doesn't exist yet, or doesn't hold a feed. reading starts with the next frame published;
+    // call SeekToOldest to read what is already in the ring.
+    bool Open( const std::string& name );
+    void Close();
+    void SeekToOldest();
+
+    // copies out the next frame; returns false when there isn't one yet.
+    bool Read( uint64_t& sequence, CanLiveFeedFrame& frame );
+
+    uint64_t GetNumMissedFrames() const;
+    uint32_t GetSampleRateHz() const;
+
+  protected:
+    const CanLiveFeedHeader* mHeader; // NULL when closed
+    const CanLiveFeedSlot* mSlots;
+    uint64_t mMappingSize;
+    uint64_t mNextSequence;
+    uint64_t mNumMissedFrames;
+};
+
+#endif // CAN_LIVE_FEED_READER
@@ -0,0 +1,245 @@
+#include "CanLogReader.h"
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    const char* SkipSpaces( const char* p )
+    {
+        while( *p == ' ' || *p == '\t' )
+            p++;
+        return p;
+    }
+
+    S32 HexDigit( char c )
+    {
+        if( c >= '0' && c <= '9' )
+            return c - '0';
+        if( c >= 'a' && c <= 'f' )
+            return c - 'a' + 10;
+        if( c >= 'A' && c <= 'F' )
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    // seconds with up to 9 decimals, kept as integer nanoseconds: a double can't hold a Unix time to the microsecond.
+    bool ReadTime( const char*& p, U64& time_ns )
+    {
+        if( *p < '0' || *p > '9' )
+            return false;
+
+        U64 seconds = 0;
+        while( *p >= '0' && *p <= '9' )
+            seconds = seconds * 10 + U64( *p++ - '0' );
+
+        U64 fraction_ns = 0;
+        U64 digit_ns = 100000000;
+        if( *p == '.' )
+        {
+            p++;
+            for( ; *p >= '0' && *p <= '9'; p++ )
+            {
+                fraction_ns += U64( *p - '0' ) * digit_ns;
+                digit_ns /= 10;
+            }
+        }
+
+        time_ns = seconds * 1000000000ull + fraction_ns;
+        return true;
+    }
+
+    // a whole whitespace delimited number; returns the number of digits, 0 if there's no number here.
+    U32 ReadNumber( const char*& p, U32& value, bool hex )
+    {
+        U32 num_digits = 0;
+        value = 0;
+        for( ;; )
+        {
+            S32 digit = HexDigit( *p );
+            if( digit < 0 || ( hex == false && digit > 9 ) )
+                break;
+            value = value * ( hex ? 16 : 10 ) + U32( digit );
+            num_digits++;
+            p++;
+        }
+        return num_digits;
+    }
+}
+
+CanLogReader::CanLogReader() : mAscHexBase( true ), mAscRelativeTimes( false ), mAscPreviousTimeNs( 0 )
+{
+}
+
+CanLogReader::~CanLogReader()
+{
+}
+
+bool CanLogReader::Open( const std::string& path )
+{
+    Close();
+    mFile.open( path.c_str() );
+    return mFile.is_open();
+}
+
+void CanLogReader::Close()
+{
+    if( mFile.is_open() )
+        mFile.close();
+    mFile.clear();
+    mAscHexBase = true;
+    mAscRelativeTimes = false;
+    mAscPreviousTimeNs = 0;
+}
+
+bool CanLogReader::IsOpen() const
+{
+    return mFile.is_open();
+}
+
+bool CanLogReader::ReadFrame( CanLogFrame& frame )
+{
+    while( std::getline( mFile, mLine ) )
+    {
+        const char* p = SkipSpaces( mLine.c_str() );
+
+        if( *p == '(' )
+        {
+            if( ParseCandumpLine( p, frame ) )
+                return true;
+        }
+        else if( *p >= '0' && *p <= '9' )
+        {
+            if( ParseAscLine( p, frame ) )
+                return true;
+        }
+        else if( strncmp( p, "base ", 5 ) == 0 )
+        {
+            // base hex|dec  timestamps absolute|relative
+            mAscHexBase = strncmp( SkipSpaces( p + 5 ), "dec", 3 ) != 0;
+            mAscRelativeTimes = strstr( p, "relative" ) != NULL;
+        }
+    }
+
+    return false;
+}
+
+void CanLogReader::Rewind()
+{
+    mFile.clear();
+    mFile.seekg( 0 );
+    mAscHexBase = true;
+    mAscRelativeTimes = false;
+    mAscPreviousTimeNs = 0;
+}
+
+bool CanLogReader::ParseCandumpLine( const char* line, CanLogFrame& frame )
+{
+    // (<seconds>) <interface> <id>#<data>, or <id>#R[<dlc>] for a remote frame. extended identifiers are written with 8
+    // digits. CAN FD frames (<id>##<flags><data>) are skipped, as are error frames, which have bit 29 of the identifier set.
+    const char* p = line + 1;
+    if( ReadTime( p, frame.mTimeNs ) == false || *p != ')' )
+        return false;
+
+    p = SkipSpaces( p + 1 );
+    while( *p != 0 && *p != ' ' && *p != '\t' )
+        p++;
+    p = SkipSpaces( p );
+
+    U32 num_digits = ReadNumber( p, frame.mIdentifier, true );
+    if( *p != '#' || ( num_digits != 3 && num_digits != 8 ) || frame.mIdentifier > 0x1FFFFFFF )
+        return false;
+    if( num_digits == 3 && frame.mIdentifier > 0x7FF )
+        return false; // too big for an 11-bit identifier
+    frame.mExtended = num_digits == 8;
+    p++;
+
+    if( *p == '#' )
+        return false;
+
+    frame.mRemoteFrame = *p == 'R' || *p == 'r';
+    if( frame.mRemoteFrame )
+    {
+        p++;
+        frame.mDlc = 0;
+        if( HexDigit( *p ) >= 0 && ReadNumber( p, frame.mDlc, true ) != 1 )
+            return false;
+        return frame.mDlc <= 8;
+    }
+
+    frame.mDlc = 0;
+    for( ;; )
+    {
+        if( *p == '.' )
+            p++;
+
+        S32 high = HexDigit( p[ 0 ] );
+        if( high < 0 )
+            break;
+        S32 low = HexDigit( p[ 1 ] );
+        if( low < 0 || frame.mDlc == 8 )
+            return false;
+
+        frame.mData[ frame.mDlc++ ] = U8( high * 16 + low );
+        p += 2;
+    }
+
+    return true;
+}
+
+bool CanLogReader::ParseAscLine( const char* line, CanLogFrame& frame )
+{
+    // <seconds> <channel> <id>[x] Rx|Tx d <dlc> <data bytes>..., or r [<dlc>] for a remote frame. anything else with a time,
+    // like ErrorFrame or CAN FD lines, is skipped.
+    const char* p = line;
+    U64 time_ns;
+    if( ReadTime( p, time_ns ) == false )
+        return false;
+
+    U32 channel;
+    p = SkipSpaces( p );
+    if( ReadNumber( p, channel, false ) == 0 )
+        return false;
+
+    p = SkipSpaces( p );
+    if( ReadNumber( p, frame.mIdentifier, mAscHexBase ) == 0 )
+        return false;
+    frame.mExtended = *p == 'x' || *p == 'X';
+    if( frame.mExtended )
+        p++;
+    if( frame.mIdentifier > ( frame.mExtended ? 0x1FFFFFFFu : 0x7FFu ) )
+        return false;
+
+    p = SkipSpaces( p );
+    if( strncmp( p, "Rx", 2 ) != 0 && strncmp( p, "Tx", 2 ) != 0 )
+        return false;
+
+    p = SkipSpaces( p + 2 );
+    if( ( *p != 'd' && *p != 'r' ) || ( p[ 1 ] != ' ' && p[ 1 ] != '\t' && p[ 1 ] != 0 ) )
+        return false;
+    frame.mRemoteFrame = *p == 'r';
+
+    p = SkipSpaces( p + 1 );
+    frame.mDlc = 0;
+    if( ReadNumber( p, frame.mDlc, true ) == 0 && frame.mRemoteFrame == false )
+        return false;
+    if( frame.mDlc > 8 )
+        return false;
+
+    if( frame.mRemoteFrame == false )
+    {
+        for( U32 i = 0; i < frame.mDlc; i++ )
+        {
+            U32 value;
+            p = SkipSpaces( p );
+            if( ReadNumber( p, value, mAscHexBase ) == 0 || value > 0xFF )
+                return false;
+            frame.mData[ i ] = U8( value );
+        }
+    }
+
+    if( mAscRelativeTimes )
+        time_ns += mAscPreviousTimeNs;
+    mAscPreviousTimeNs = time_ns;
+    frame.mTimeNs = time_ns;
+    return true;
+}
@@ -0,0 +1,48 @@
+#ifndef CAN_LOG_READER
+#define CAN_LOG_READER
+
+#include <AnalyzerTypes.h>
+#include <fstream>
+#include <string>
+
+// one classical data or remote frame from a log.
+struct CanLogFrame
+{
+    U64 mTimeNs; // from the log's own time base
+    U32 mIdentifier;
+    bool mExtended;
+    bool mRemoteFrame;
+    U32 mDlc;
+    U8 mData[ 8 ];
+};
+
+// Reads frames from a recorded CAN log, one line at a time, so logs of any size can be replayed.
+//
+// Two formats are understood, and can even be mixed: candump log files ("(1436509052.249713) can0 123#11223344", as written by
+// candump -l) and Vector ASC files ("0.015991 1 123 Rx d 4 11 22 33 44"). Lines that aren't classical data or remote frames,
+// like headers, comments, CAN FD frames and error frames, are skipped.
+class CanLogReader
+{
+  public:
+    CanLogReader();
+    ~CanLogReader();
+
+    bool Open( const std::string& path );
+    void Close();
+    bool IsOpen() const;
+
+    bool ReadFrame( CanLogFrame& frame ); // false at the end of the log
+    void Rewind();
+
+  protected:
+    bool ParseCandumpLine( const char* line, CanLogFrame& frame );
+    bool ParseAscLine( const char* line, CanLogFrame& frame );
+
+    std::ifstream mFile;
+    std::string mLine;
+    bool mAscHexBase;          // ASC "base dec" files have decimal identifiers and data
+    bool mAscRelativeTimes;    // ASC "timestamps relative" files give the time since the previous frame
+    U64 mAscPreviousTimeNs;
+};
+
+#endif // CAN_LOG_READER
@@ -0,0 +1,24 @@
+#ifndef CAN_MESSAGE
+#define CAN_MESSAGE
+
+#include <AnalyzerTypes.h>
+
+// FNV-1a over every data byte of a frame, started from CAN_PAYLOAD_HASH_START.
+#define CAN_PAYLOAD_HASH_START 0xCBF29CE484222325ull
+#define CAN_PAYLOAD_HASH( hash, byte ) ( ( ( hash ) ^ U8( byte ) ) * 0x100000001B3ull )
+
+// a complete data or remote frame, assembled from the decoded fields once its packet is committed.
+struct CanMessage
+{
+    U32 mIdentifier;
+    bool mExtended;
+    bool mRemoteFrame;
+    U32 mDlc;
+    U32 mNumDataBytes; // only the first 8 bytes of a CAN XL payload are kept
+    U8 mData[ 8 ];
+    U64 mPayloadHash; // of the whole payload, so CAN XL frames that only differ past mData can be told apart
+    U64 mStartingSample;
+    U64 mEndingSample;
+};
+
+#endif // CAN_MESSAGE
@@ -0,0 +1,26 @@
+#ifndef CAN_OFFLINE_CHANNEL
+#define CAN_OFFLINE_CHANNEL
+
+#include <AnalyzerTypes.h>
+
+// thrown when the decoder moves past the last sample of an offline channel, the way the SDK channel ends the worker thread.
+struct CanEndOfSamples
+{
+};
+
+// A capture decoded outside the Logic software, with the calls CanFrameDecoder makes on AnalyzerChannelData.
+class CanOfflineChannel
+{
+  public:
+    virtual ~CanOfflineChannel()
+    {
+    }
+
+    virtual U64 GetSampleNumber() const = 0;
+    virtual BitState GetBitState() const = 0;
+    virtual void AdvanceToNextEdge() = 0;
+    virtual U32 AdvanceToAbsPosition( U64 sample ) = 0; // returns the number of edges passed
+    virtual bool WouldAdvancingCauseTransition( U32 num_samples ) const = 0;
+};
+
+#endif // CAN_OFFLINE_CHANNEL
@@ -0,0 +1,113 @@
+#include "CanParallelExport.h"
+
+CanParallelExport::CanParallelExport( U64 first_packet, U64 end_packet, const ReadFunction& read, const FormatFunction& format )
+    : mRead( read ),
+      mFormat( format ),
+      mFirstPacket( first_packet ),
+      mEndPacket( end_packet ),
+      mNumChunks( ( end_packet - first_packet + CAN_EXPORT_CHUNK_PACKETS - 1 ) / CAN_EXPORT_CHUNK_PACKETS ),
+      mNextChunkToRead( 0 ),
+      mNextChunkToFormat( 0 ),
+      mNextChunkToWrite( 0 ),
+      mCancelled( false )
+{
+    U64 num_workers = std::thread::hardware_concurrency();
+    if( num_workers == 0 )
+        num_workers = 1;
+    if( num_workers > mNumChunks )
+        num_workers = mNumChunks;
+
+    mSlots.resize( size_t( num_workers * CAN_EXPORT_SLOTS_PER_THREAD ) );
+    for( size_t i = 0; i < mSlots.size(); i++ )
+        mSlots[ i ].mFormatted = false;
+
+    for( U64 i = 0; i < num_workers; i++ )
+        mWorkers.push_back( std::thread( &CanParallelExport::WorkerThread, this ) );
+}
+
+CanParallelExport::~CanParallelExport()
+{
+    {
+        std::lock_guard<std::mutex> lock( mMutex );
+        mCancelled = true;
+    }
+    mCondition.notify_all();
+
+    for( size_t i = 0; i < mWorkers.size(); i++ )
+        mWorkers[ i ].join();
+}
+
+bool CanParallelExport::GetNextChunk( std::string& text, U64& end_packet )
+{
+    if( mNextChunkToWrite == mNumChunks )
+        return false;
+
+    ReadAhead();
+
+    std::unique_lock<std::mutex> lock( mMutex );
+    Chunk& chunk = mSlots[ size_t( mNextChunkToWrite % mSlots.size() ) ];
+    mCondition.wait( lock, [&chunk]() { return chunk.mFormatted; } );
+
+    // the caller's old buffer goes back into the slot, so its memory is reused for a later chunk.
+    text.swap( chunk.mText );
+    chunk.mFormatted = false;
+    mNextChunkToWrite++;
+    end_packet = mFirstPacket + mNextChunkToWrite * CAN_EXPORT_CHUNK_PACKETS;
+    if( end_packet > mEndPacket )
+        end_packet = mEndPacket;
+
+    return true;
+}
+
+void CanParallelExport::ReadAhead()
+{
+    // a slot is free once the chunk before it in that slot has been written, and only this thread writes chunks, so the
+    // slots ahead can be filled without holding the lock.
+    while( mNextChunkToRead < mNumChunks && mNextChunkToRead < mNextChunkToWrite + mSlots.size() )
+    {
+        U64 first_packet = mFirstPacket + mNextChunkToRead * CAN_EXPORT_CHUNK_PACKETS;
+        U64 end_packet = first_packet + CAN_EXPORT_CHUNK_PACKETS < mEndPacket ? first_packet + CAN_EXPORT_CHUNK_PACKETS : mEndPacket;
+
+        CanExportFrames& frames = mSlots[ size_t( mNextChunkToRead % mSlots.size() ) ].mFrames;
+        frames.mPackets.clear();
+        frames.mFrames.clear();
+        mRead( first_packet, end_packet, frames );
+
+        {
+            std::lock_guard<std::mutex> lock( mMutex );
+            mNextChunkToRead++;
+        }
+        mCondition.notify_all();
+    }
+}
+
+void CanParallelExport::WorkerThread()
+{
+    std::string text;
+
+    for( ;; )
+    {
+        U64 chunk_index;
+        {
+            std::unique_lock<std::mutex> lock( mMutex );
+            mCondition.wait( lock, [this]() {
+                return mCancelled || mNextChunkToFormat == mNumChunks || mNextChunkToFormat < mNextChunkToRead;
+            } );
+            if( mCancelled || mNextChunkToFormat == mNumChunks )
+                return;
+
+            chunk_index = mNextChunkToFormat++;
+        }
+
+        Chunk& chunk = mSlots[ size_t( chunk_index % mSlots.size() ) ];
+        text.clear();
+        mFormat( chunk.mFrames, text );
+
+        {
+            std::lock_guard<std::mutex> lock( mMutex );
+            chunk.mText.swap( text );
+            chunk.mFormatted = true;
+        }
+        mCondition.notify_all();
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef CAN_PARALLEL_EXPORT
+#define CAN_PARALLEL_EXPORT
+
+#include <AnalyzerResults.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CAN_EXPORT_CHUNK_PACKETS 4096 // packets read and formatted at a time
+#define CAN_EXPORT_SLOTS_PER_THREAD 2 // chunks read ahead of the writer, per worker
+
+// a packet of a chunk: its frames are mFrames[ mFirstFrame ] onwards.
+struct CanExportPacket
+{
+    U64 mPacketId;
+    size_t mFirstFrame;
+    size_t mNumFrames;
+};
+
+// copies of the frames of the packets in a chunk, so the workers never touch the results.
+struct CanExportFrames
+{
+    std::vector<CanExportPacket> mPackets;
+    std::vector<Frame> mFrames;
+};
+
+// Formats a range of packets for an export on a pool of worker threads, a chunk of packets at a time, and hands the text back in packet
+// order to the thread that writes the file.
+//
+// The SDK doesn't say that its results can be read from several threads at once, so only the writing thread reads them: it copies
+// the frames of the chunks ahead of it, and the workers format the copies. Workers only run a bounded number of chunks ahead of
+// the writer, so memory use doesn't grow with the capture. Destroying the export before the last chunk cancels the rest.
+class CanParallelExport
+{
+  public:
+    typedef std::function<void( U64 first_packet, U64 end_packet, CanExportFrames& frames )> ReadFunction; // on the writing thread
+    typedef std::function<void( const CanExportFrames& frames, std::string& text )> FormatFunction;       // appends to text
+
+    CanParallelExport( U64 first_packet, U64 end_packet, const ReadFunction& read, const FormatFunction& format );
+    ~CanParallelExport();
+
+    bool GetNextChunk( std::string& text, U64& end_packet ); // false when every chunk has been handed back
+
+  protected:
+    struct Chunk
+    {
+        CanExportFrames mFrames;
+        std::string mText;
+        bool mFormatted;
+    };
+
+    void ReadAhead();
+    void WorkerThread();
+
+    ReadFunction mRead;
+    FormatFunction mFormat;
+    U64 mFirstPacket;
+    U64 mEndPacket;
+    U64 mNumChunks;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::vector<Chunk> mSlots; // chunk n is read and formatted into slot n % mSlots.size()
+    U64 mNextChunkToRead;
+    U64 mNextChunkToFormat;
+    U64 mNextChunkToWrite;
+    bool mCancelled;
+
+    std::vector<std::thread> mWorkers;
+};
+
+#endif // CAN_PARALLEL_EXPORT
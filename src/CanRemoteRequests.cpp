@@ -0,0 +1,57 @@
+#include "CanRemoteRequests.h"
+
+CanRemoteRequests::CanRemoteRequests() : mNumPending( 0 ), mTimeoutSamples( 0 )
+{
+    Reset( 0 );
+}
+
+CanRemoteRequests::~CanRemoteRequests()
+{
+}
+
+void CanRemoteRequests::Reset( U32 sample_rate_hz )
+{
+    for( U32 i = 0; i < REMOTE_REQUEST_SLOTS; i++ )
+        mPending[ i ].mInUse = false;
+
+    mNumPending = 0;
+    mTimeoutSamples = U64( double( sample_rate_hz ) * REMOTE_RESPONSE_TIMEOUT_S );
+}
+
+bool CanRemoteRequests::ProcessMessage( const CanMessage& message, U64& latency_samples )
+{
+    // most buses carry no remote frames at all; don't hash every data frame for nothing.
+    if( message.mRemoteFrame == false && mNumPending == 0 )
+        return false;
+
+    U64 key = RequestKey( message );
+    PendingRequest& slot = mPending[ ( ( key * 0x9E3779B97F4A7C15ull ) >> 32 ) & ( REMOTE_REQUEST_SLOTS - 1 ) ];
+
+    if( message.mRemoteFrame == true )
+    {
+        if( slot.mInUse == false )
+            mNumPending++;
+
+        slot.mInUse = true;
+        slot.mKey = key;
+        slot.mEndingSample = message.mEndingSample;
+        return false;
+    }
+
+    if( slot.mInUse == false || slot.mKey != key )
+        return false;
+
+    slot.mInUse = false;
+    mNumPending--;
+
+    if( message.mStartingSample < slot.mEndingSample || message.mStartingSample - slot.mEndingSample > mTimeoutSamples )
+        return false;
+
+    latency_samples = message.mStartingSample - slot.mEndingSample;
+    return true;
+}
+
+U64 CanRemoteRequests::RequestKey( const CanMessage& message )
+{
+    return ( U64( message.mIdentifier ) << 5 ) | ( message.mExtended ? 0x10 : 0 ) | ( message.mDlc & 0xF );
+}
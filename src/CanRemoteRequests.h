@@ -0,0 +1,41 @@
+#ifndef CAN_REMOTE_REQUESTS
+#define CAN_REMOTE_REQUESTS
+
+#include "CanMessage.h"
+#include <vector>
+
+#define REMOTE_REQUEST_SLOTS 256 // pending request table, must be a power of two
+#define REMOTE_RESPONSE_TIMEOUT_S 1.0
+
+// Matches remote frames to the data frames that answer them.
+//
+// A remote frame is held in a direct-mapped table keyed by identifier and DLC until the next data frame with the same
+// identifier and DLC arrives, which is taken as its response. The table is fixed size, so a request that collides with
+// another outstanding request, or that goes unanswered for REMOTE_RESPONSE_TIMEOUT_S, is dropped.
+class CanRemoteRequests
+{
+  public:
+    CanRemoteRequests();
+    ~CanRemoteRequests();
+
+    void Reset( U32 sample_rate_hz );
+
+    // returns true when message answers a pending request, with the time from the end of the request to the response.
+    bool ProcessMessage( const CanMessage& message, U64& latency_samples );
+
+  protected:
+    struct PendingRequest
+    {
+        bool mInUse;
+        U64 mKey;
+        U64 mEndingSample;
+    };
+
+    U64 RequestKey( const CanMessage& message );
+
+    PendingRequest mPending[ REMOTE_REQUEST_SLOTS ];
+    U32 mNumPending;
+    U64 mTimeoutSamples;
+};
+
+#endif // CAN_REMOTE_REQUESTS
@@ -0,0 +1,272 @@
+#include "CanResultsCache.h"
+#include <cstring>
+
+namespace
+{
+    const char gCacheMagic[ 8 ] = { 'C', 'A', 'N', 'R', 'C', 'v', '6', 0 };
+
+    const U8 gPacketCommitTag = 0xFF;
+    const U8 gPacketCancelTag = 0xFE;
+    const U8 gMaxFrameType = 0x7F;
+
+    U64 Fnv1a( U64 hash, const void* data, size_t length )
+    {
+        const U8* bytes = ( const U8* )data;
+        for( size_t i = 0; i < length; i++ )
+        {
+            hash ^= bytes[ i ];
+            hash *= 0x100000001B3ull;
+        }
+        return hash;
+    }
+
+    U64 ZigZag( S64 value )
+    {
+        return ( U64( value ) << 1 ) ^ U64( value >> 63 );
+    }
+
+    S64 UnZigZag( U64 value )
+    {
+        return S64( value >> 1 ) ^ -S64( value & 1 );
+    }
+}
+
+CanResultsCache::CanResultsCache() : mState( Disabled ), mFile( NULL ), mFileIsClean( false ), mInPacket( false ), mKeyBytes( 0 ), mNumRecordedPackets( 0 )
+{
+}
+
+CanResultsCache::~CanResultsCache()
+{
+    Close();
+}
+
+void CanResultsCache::Reset( const std::string& folder )
+{
+    Close();
+
+    mFolder = folder;
+    mState = mFolder.empty() ? Disabled : KeyPending;
+    mPending.clear();
+    mKeyBytes = 0;
+    mNumRecordedPackets = 0;
+    mPreviousStart = 0;
+}
+
+bool CanResultsCache::IsKeyPending()
+{
+    return mState == KeyPending;
+}
+
+bool CanResultsCache::IsReplaying()
+{
+    return mState == Replaying;
+}
+
+void CanResultsCache::RecordFrame( const Frame& frame )
+{
+    if( mState != KeyPending && mState != Writing )
+        return;
+
+    mPending.push_back( frame.mType );
+    mPending.push_back( frame.mFlags );
+    PutVarint( ZigZag( frame.mStartingSampleInclusive - mPreviousStart ) );
+    PutVarint( U64( frame.mEndingSampleInclusive - frame.mStartingSampleInclusive ) );
+    PutVarint( frame.mData1 );
+
+    mPreviousStart = frame.mStartingSampleInclusive;
+}
+
+void CanResultsCache::RecordPacket( bool committed, U64 start_of_frame, U32 occupied_bits, U64 resume_sample, bool error_flag )
+{
+    if( mState != KeyPending && mState != Writing )
+        return;
+
+    mPending.push_back( committed ? gPacketCommitTag : gPacketCancelTag );
+    PutVarint( ZigZag( S64( start_of_frame ) - mPreviousStart ) );
+    PutVarint( occupied_bits );
+    PutVarint( ( ( resume_sample - start_of_frame ) << 1 ) | ( error_flag ? 1 : 0 ) );
+    mNumRecordedPackets++;
+
+    if( mState == Writing )
+        WritePending();
+}
+
+U32 CanResultsCache::GetNumRecordedPackets()
+{
+    return mNumRecordedPackets;
+}
+
+bool CanResultsCache::Open( const char* settings, U32 sample_rate )
+{
+    if( mState != KeyPending )
+        return false;
+
+    mKeyBytes = mPending.size();
+
+    U64 key = 0xCBF29CE484222325ull;
+    key = Fnv1a( key, settings, strlen( settings ) );
+    key = Fnv1a( key, &sample_rate, sizeof( sample_rate ) );
+    key = Fnv1a( key, mPending.data(), mPending.size() );
+
+    char name[ 64 ];
+    snprintf( name, sizeof( name ), "/can_%016llx.cache", ( unsigned long long )key );
+    mPath = mFolder + name;
+
+    // an existing cache must begin with exactly the packets we just decoded.
+    mFile = fopen( mPath.c_str(), "rb" );
+    if( mFile != NULL )
+    {
+        char magic[ sizeof( gCacheMagic ) ];
+        std::vector<U8> prefix( mKeyBytes );
+
+        bool matches = fread( magic, 1, sizeof( magic ), mFile ) == sizeof( magic ) && memcmp( magic, gCacheMagic, sizeof( magic ) ) == 0 &&
+                       fread( prefix.data(), 1, prefix.size(), mFile ) == prefix.size() && prefix == mPending;
+
+        if( matches == true )
+        {
+            mState = Replaying;
+            mFileIsClean = true;
+            mInPacket = false;
+            mPending.clear();
+            return true;
+        }
+
+        Close();
+    }
+
+    mFile = fopen( mPath.c_str(), "wb" );
+    if( mFile == NULL )
+    {
+        mState = Disabled;
+        return false;
+    }
+
+    fwrite( gCacheMagic, 1, sizeof( gCacheMagic ), mFile );
+    mState = Writing;
+    WritePending();
+    return false;
+}
+
+CanResultsCache::RecordType CanResultsCache::ReadRecord( Frame& frame, U64& start_of_frame, U32& occupied_bits, U64& resume_sample,
+                                                        bool& error_flag )
+{
+    if( mState != Replaying )
+        return EndOfCache;
+
+    int tag = fgetc( mFile );
+    if( tag == EOF )
+    {
+        // an interrupted analysis can leave a partial packet at the end; it must not be extended.
+        if( mInPacket == true )
+            mFileIsClean = false;
+        return EndOfCache;
+    }
+
+    if( tag == gPacketCommitTag || tag == gPacketCancelTag )
+    {
+        U64 start_delta;
+        U64 bits;
+        U64 resume;
+        if( GetVarint( start_delta ) == false || GetVarint( bits ) == false || GetVarint( resume ) == false )
+        {
+            mFileIsClean = false;
+            return EndOfCache;
+        }
+
+        start_of_frame = U64( mPreviousStart + UnZigZag( start_delta ) );
+        occupied_bits = U32( bits );
+        resume_sample = start_of_frame + ( resume >> 1 );
+        error_flag = ( resume & 1 ) != 0;
+        mInPacket = false;
+        return tag == gPacketCommitTag ? PacketCommitRecord : PacketCancelRecord;
+    }
+
+    int flags = fgetc( mFile );
+    U64 start_delta;
+    U64 length;
+    U64 data1;
+
+    if( tag > gMaxFrameType || flags == EOF || GetVarint( start_delta ) == false || GetVarint( length ) == false ||
+        GetVarint( data1 ) == false )
+    {
+        // truncated or damaged; stop here and don't append to this file.
+        mFileIsClean = false;
+        return EndOfCache;
+    }
+
+    frame.mType = U8( tag );
+    frame.mFlags = U8( flags );
+    frame.mStartingSampleInclusive = mPreviousStart + UnZigZag( start_delta );
+    frame.mEndingSampleInclusive = frame.mStartingSampleInclusive + S64( length );
+    frame.mData1 = data1;
+
+    mInPacket = true;
+    mPreviousStart = frame.mStartingSampleInclusive;
+    return FrameRecord;
+}
+
+void CanResultsCache::StopReplay( bool keep_file )
+{
+    if( mState != Replaying )
+        return;
+
+    // what follows in the file was never checked against this capture, so nothing is appended after it.
+    Close();
+    if( keep_file == false )
+        remove( mPath.c_str() );
+    mState = Disabled;
+}
+
+void CanResultsCache::FinishReplay()
+{
+    if( mState != Replaying )
+        return;
+
+    Close();
+
+    // keep extending the cache if the previous analysis stopped early (or the capture is still growing).
+    if( mFileIsClean == true )
+        mFile = fopen( mPath.c_str(), "ab" );
+
+    mState = mFile != NULL ? Writing : Disabled;
+}
+
+void CanResultsCache::Close()
+{
+    if( mFile != NULL )
+        fclose( mFile );
+    mFile = NULL;
+}
+
+void CanResultsCache::WritePending()
+{
+    if( mPending.empty() == false )
+        fwrite( mPending.data(), 1, mPending.size(), mFile );
+    mPending.clear();
+}
+
+void CanResultsCache::PutVarint( U64 value )
+{
+    while( value >= 0x80 )
+    {
+        mPending.push_back( U8( value | 0x80 ) );
+        value >>= 7;
+    }
+    mPending.push_back( U8( value ) );
+}
+
+bool CanResultsCache::GetVarint( U64& value )
+{
+    value = 0;
+    for( U32 shift = 0; shift < 64; shift += 7 )
+    {
+        int byte = fgetc( mFile );
+        if( byte == EOF )
+            return false;
+
+        value |= U64( byte & 0x7F ) << shift;
+        if( ( byte & 0x80 ) == 0 )
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,81 @@
+#ifndef CAN_RESULTS_CACHE
+#define CAN_RESULTS_CACHE
+
+#include <AnalyzerResults.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// the cache key covers the decoding settings, the sample rate and the results of this many leading packets.
+#define RESULTS_CACHE_KEY_PACKETS 16
+
+// On-disk cache of decoded results.
+//
+// While decoding, every frame and packet boundary is appended to a compact binary file (delta/varint encoded). The file is
+// named after a hash of the settings that affect decoding, the sample rate and the first RESULTS_CACHE_KEY_PACKETS decoded
+// packets, so a capture is identified by its own contents. When the analyzer is run again on the same capture with the same
+// decoding settings, the cached results are replayed instead of decoded, and decoding resumes where the cache ends. The key
+// can't tell apart captures that only differ later on, so the analyzer checks each replayed packet against the channel, and
+// stops the replay with StopReplay at the first one that isn't there.
+class CanResultsCache
+{
+  public:
+    enum RecordType
+    {
+        FrameRecord,
+        PacketCommitRecord,
+        PacketCancelRecord,
+        EndOfCache
+    };
+
+    CanResultsCache();
+    ~CanResultsCache();
+
+    void Reset( const std::string& folder );
+
+    bool IsKeyPending();
+    bool IsReplaying();
+
+    void RecordFrame( const Frame& frame );
+    // resume_sample is where the channel was left after the frame, and error_flag says the bus was then waited on to go idle.
+    void RecordPacket( bool committed, U64 start_of_frame, U32 occupied_bits, U64 resume_sample, bool error_flag );
+    U32 GetNumRecordedPackets();
+
+    // computes the key from the recorded packets; returns true when a matching cache file is ready to replay.
+    // otherwise a new cache file is started with the packets recorded so far.
+    bool Open( const char* settings, U32 sample_rate );
+
+    // packet records also return the frame's start of frame sample, the number of bits it occupied the bus for, and where
+    // decoding went on from.
+    RecordType ReadRecord( Frame& frame, U64& start_of_frame, U32& occupied_bits, U64& resume_sample, bool& error_flag );
+    void StopReplay( bool keep_file ); // the rest of the cache isn't replayed; a cache for another capture isn't kept
+    void FinishReplay();
+
+  protected:
+    enum State
+    {
+        Disabled,
+        KeyPending,
+        Replaying,
+        Writing
+    };
+
+    void Close();
+    void WritePending();
+    void PutVarint( U64 value );
+    bool GetVarint( U64& value );
+
+    State mState;
+    std::string mFolder;
+    std::string mPath;
+    FILE* mFile;
+    bool mFileIsClean;
+    bool mInPacket;
+
+    std::vector<U8> mPending;
+    U64 mKeyBytes; // number of bytes of mPending covered by the key
+    U32 mNumRecordedPackets;
+    S64 mPreviousStart;
+};
+
+#endif // CAN_RESULTS_CACHE
@@ -0,0 +1,156 @@
+#include "CanSampleBuffer.h"
+#include <cstring>
+
+#if defined( __AVX2__ )
+#include <immintrin.h>
+#elif defined( __SSE2__ ) || defined( _M_X64 )
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+    U32 CountTrailingZeros( U64 value ) // value isn't 0
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64( &index, value );
+        return U32( index );
+#else
+        return U32( __builtin_ctzll( value ) );
+#endif
+    }
+}
+
+CanSampleBuffer::CanSampleBuffer() : mSamples( NULL ), mNumSamples( 0 ), mSampleNumber( 0 ), mLevel( 0 ), mNextEdge( 0 )
+{
+}
+
+CanSampleBuffer::CanSampleBuffer( const U8* samples, U64 num_samples )
+{
+    SetSamples( samples, num_samples );
+}
+
+void CanSampleBuffer::SetSamples( const U8* samples, U64 num_samples )
+{
+    mSamples = samples;
+    mNumSamples = num_samples;
+    mSampleNumber = 0;
+    mLevel = num_samples > 0 ? GetSample( 0 ) : 0;
+    mNextEdge = FindNextChange( 1, mLevel );
+}
+
+U64 CanSampleBuffer::GetNumSamples() const
+{
+    return mNumSamples;
+}
+
+U64 CanSampleBuffer::GetSampleNumber() const
+{
+    return mSampleNumber;
+}
+
+BitState CanSampleBuffer::GetBitState() const
+{
+    return mLevel != 0 ? BIT_HIGH : BIT_LOW;
+}
+
+void CanSampleBuffer::AdvanceToNextEdge()
+{
+    if( mNextEdge >= mNumSamples )
+        throw CanEndOfSamples();
+
+    mSampleNumber = mNextEdge;
+    mLevel ^= 1;
+    mNextEdge = FindNextChange( mSampleNumber + 1, mLevel );
+}
+
+U32 CanSampleBuffer::AdvanceToAbsPosition( U64 sample )
+{
+    if( sample >= mNumSamples )
+        throw CanEndOfSamples();
+
+    U32 num_edges = 0;
+    while( mNextEdge <= sample )
+    {
+        mLevel ^= 1;
+        num_edges++;
+        mNextEdge = FindNextChange( mNextEdge + 1, mLevel );
+    }
+
+    mSampleNumber = sample;
+    return num_edges;
+}
+
+bool CanSampleBuffer::WouldAdvancingCauseTransition( U32 num_samples ) const
+{
+    return mNextEdge < mNumSamples && mNextEdge <= mSampleNumber + num_samples;
+}
+
+U64 CanSampleBuffer::FindNextChange( U64 sample, U32 level ) const
+{
+    if( sample >= mNumSamples )
+        return mNumSamples;
+
+    // XORed with a word of samples at level, the samples that aren't at level are the set bits. words are loaded little endian,
+    // so sample order is bit order.
+    const U64 level_word = level != 0 ? ~0ull : 0ull;
+    const U64 num_bytes = ( mNumSamples + 7 ) / 8;
+
+    // the last word may run past the buffer; its missing bytes are read as zeroes, and anything found past the last sample is
+    // clamped below.
+    U64 word_index = sample / 64;
+    U64 word = 0;
+    U64 word_bytes = num_bytes - word_index * 8 < 8 ? num_bytes - word_index * 8 : 8;
+    memcpy( &word, mSamples + word_index * 8, size_t( word_bytes ) );
+    word = ( word ^ level_word ) & ( ~0ull << ( sample % 64 ) );
+
+    for( ;; )
+    {
+        if( word != 0 )
+        {
+            U64 change = word_index * 64 + CountTrailingZeros( word );
+            return change < mNumSamples ? change : mNumSamples;
+        }
+
+        word_index++;
+        if( word_index * 8 >= num_bytes )
+            return mNumSamples;
+
+        // skip whole blocks at level; the block with the change is left to the word loop.
+#if defined( __AVX2__ )
+        const __m256i level_block = _mm256_set1_epi8( char( level_word ) );
+        while( word_index * 8 + 32 <= num_bytes )
+        {
+            __m256i block = _mm256_loadu_si256( ( const __m256i* )( mSamples + word_index * 8 ) );
+            if( U32( _mm256_movemask_epi8( _mm256_cmpeq_epi8( block, level_block ) ) ) != 0xFFFFFFFF )
+                break;
+            word_index += 4;
+        }
+#elif defined( __SSE2__ ) || defined( _M_X64 )
+        const __m128i level_block = _mm_set1_epi8( char( level_word ) );
+        while( word_index * 8 + 16 <= num_bytes )
+        {
+            __m128i block = _mm_loadu_si128( ( const __m128i* )( mSamples + word_index * 8 ) );
+            if( U32( _mm_movemask_epi8( _mm_cmpeq_epi8( block, level_block ) ) ) != 0xFFFF )
+                break;
+            word_index += 2;
+        }
+#endif
+        if( word_index * 8 >= num_bytes )
+            return mNumSamples;
+
+        word = 0;
+        word_bytes = num_bytes - word_index * 8 < 8 ? num_bytes - word_index * 8 : 8;
+        memcpy( &word, mSamples + word_index * 8, size_t( word_bytes ) );
+        word ^= level_word;
+    }
+}
+
+U32 CanSampleBuffer::GetSample( U64 sample ) const
+{
+    return ( mSamples[ sample / 8 ] >> ( sample % 8 ) ) & 1;
+}
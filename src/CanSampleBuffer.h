@@ -0,0 +1,38 @@
+#ifndef CAN_SAMPLE_BUFFER
+#define CAN_SAMPLE_BUFFER
+
+#include "CanOfflineChannel.h"
+
+// A capture held in memory as packed samples, one bit per sample, least significant bit first (sample n is bit n % 8 of byte
+// n / 8).
+//
+// Edges are found by comparing whole blocks of samples against the current level: AVX2 takes 256 samples per compare and
+// SSE2 128, depending on what the build targets, with a 64-bit word loop for the rest. A capture sampled well above the bit
+// rate is mostly long runs, so the scan runs at about memory bandwidth.
+class CanSampleBuffer : public CanOfflineChannel
+{
+  public:
+    CanSampleBuffer();
+    CanSampleBuffer( const U8* samples, U64 num_samples ); // the samples aren't copied, and must outlive the buffer
+
+    void SetSamples( const U8* samples, U64 num_samples );
+    U64 GetNumSamples() const;
+
+    virtual U64 GetSampleNumber() const;
+    virtual BitState GetBitState() const;
+    virtual void AdvanceToNextEdge();
+    virtual U32 AdvanceToAbsPosition( U64 sample );
+    virtual bool WouldAdvancingCauseTransition( U32 num_samples ) const;
+
+  protected:
+    U64 FindNextChange( U64 sample, U32 level ) const; // the first sample from here on that isn't at level; mNumSamples if none
+    U32 GetSample( U64 sample ) const;
+
+    const U8* mSamples;
+    U64 mNumSamples;
+    U64 mSampleNumber;
+    U32 mLevel;
+    U64 mNextEdge; // mNumSamples when there are no more edges
+};
+
+#endif // CAN_SAMPLE_BUFFER
@@ -1,16 +1,31 @@
 #include "CanSimulationDataGenerator.h"
 #include "CanAnalyzerSettings.h"
 
-CanSimulationDataGenerator::CanSimulationDataGenerator()
+namespace
+{
+    void AdvanceToSample( SimulationChannelDescriptor& channel, U64 sample ) // Advance only takes 32 bits at a time
+    {
+        while( channel.GetCurrentSampleNumber() < sample )
+        {
+            U64 remaining = sample - channel.GetCurrentSampleNumber();
+            channel.Advance( U32( remaining < 0x80000000ull ? remaining : 0x80000000ull ) );
+        }
+    }
+}
+
+CanSimulationDataGenerator::CanSimulationDataGenerator() : mQueueHead( 0 ), mQueueSize( 0 ), mStopGenerator( false )
 {
 }
 
 CanSimulationDataGenerator::~CanSimulationDataGenerator()
 {
+    StopGenerator();
 }
 
 void CanSimulationDataGenerator::Initialize( U32 simulation_sample_rate, CanAnalyzerSettings* settings )
 {
+    StopGenerator();
+
     mSimulationSampleRateHz = simulation_sample_rate;
     mSettings = settings;
 
@@ -19,9 +34,19 @@ void CanSimulationDataGenerator::Initialize( U32 simulation_sample_rate, CanAnal
     mCanSimulationData.SetSampleRate( simulation_sample_rate );
     mCanSimulationData.SetInitialBitState( mSettings->Recessive() );
 
-    mCanSimulationData.Advance( mClockGenerator.AdvanceByHalfPeriod( 10.0 ) ); // insert 10 bit-periods of idle
+    mWaveform.Reset( mSettings->Recessive() );
+    mWaveform.Advance( mClockGenerator.AdvanceByHalfPeriod( 10.0 ) ); // insert 10 bit-periods of idle
 
     mValue = 0;
+
+    mLog.Close();
+    if( mSettings->mReplayLogPath.empty() == false )
+        mLog.Open( mSettings->mReplayLogPath );
+    mReplayPassStarted = false;
+    mReplayStartSample = 0;
+    mReplayFirstTimeNs = 0;
+
+    StartGenerator();
 }
 
 U32 CanSimulationDataGenerator::GenerateSimulationData( U64 largest_sample_requested, U32 sample_rate,
@@ -30,51 +55,158 @@ U32 CanSimulationDataGenerator::GenerateSimulationData( U64 largest_sample_reque
     U64 adjusted_largest_sample_requested =
         AnalyzerHelpers::AdjustSimulationTargetSample( largest_sample_requested, sample_rate, mSimulationSampleRateHz );
 
+    while( mCanSimulationData.GetCurrentSampleNumber() < adjusted_largest_sample_requested )
+    {
+        {
+            std::unique_lock<std::mutex> lock( mQueueMutex );
+            mQueueCondition.wait( lock, [this]() { return mQueueSize > 0; } );
+
+            CanSimulationSegment& segment = mQueue[ mQueueHead ];
+            mCurrentSegment.mEdges.swap( segment.mEdges );
+            mCurrentSegment.mEndSample = segment.mEndSample;
+            mQueueHead = ( mQueueHead + 1 ) % CAN_SIMULATION_QUEUE_SEGMENTS;
+            mQueueSize--;
+        }
+        mQueueCondition.notify_all();
+
+        U32 num_edges = U32( mCurrentSegment.mEdges.size() );
+        for( U32 i = 0; i < num_edges; i++ )
+        {
+            AdvanceToSample( mCanSimulationData, mCurrentSegment.mEdges[ i ] );
+            mCanSimulationData.Transition();
+        }
+        AdvanceToSample( mCanSimulationData, mCurrentSegment.mEndSample );
+    }
+
+    *simulation_channels = &mCanSimulationData;
+    return 1; // we are retuning the size of the SimulationChannelDescriptor array.  In our case, the "array" is length 1.
+}
+
+void CanSimulationDataGenerator::StartGenerator()
+{
+    mQueueHead = 0;
+    mQueueSize = 0;
+    mStopGenerator = false;
+    mGeneratorThread = std::thread( &CanSimulationDataGenerator::GeneratorThread, this );
+}
+
+void CanSimulationDataGenerator::StopGenerator()
+{
+    {
+        std::lock_guard<std::mutex> lock( mQueueMutex );
+        mStopGenerator = true;
+    }
+    mQueueCondition.notify_all();
+
+    if( mGeneratorThread.joinable() )
+        mGeneratorThread.join();
+}
+
+void CanSimulationDataGenerator::GeneratorThread()
+{
+    for( ;; )
+    {
+        // a segment is handed over once it has enough edges, or covers a second, so a quiet log doesn't hold it back.
+        U64 segment_start = mWaveform.GetCurrentSampleNumber();
+        while( mWaveform.GetNumEdges() < CAN_SIMULATION_SEGMENT_EDGES &&
+               mWaveform.GetCurrentSampleNumber() - segment_start < mSimulationSampleRateHz )
+        {
+            if( mLog.IsOpen() )
+                ReplayLog();
+            else
+                GeneratePattern();
+        }
+
+        std::unique_lock<std::mutex> lock( mQueueMutex );
+        mQueueCondition.wait( lock, [this]() { return mStopGenerator || mQueueSize < CAN_SIMULATION_QUEUE_SEGMENTS; } );
+        if( mStopGenerator )
+            return;
+
+        mWaveform.TakeSegment( mQueue[ ( mQueueHead + mQueueSize ) % CAN_SIMULATION_QUEUE_SEGMENTS ] );
+        mQueueSize++;
+        lock.unlock();
+        mQueueCondition.notify_all();
+    }
+}
+
+void CanSimulationDataGenerator::GeneratePattern()
+{
     std::vector<U8> data;
     std::vector<U8> empty_data;
 
-    while( mCanSimulationData.GetCurrentSampleNumber() < adjusted_largest_sample_requested )
-    {
-        data.clear();
-        data.push_back( mValue + 0 );
-        data.push_back( mValue + 1 );
-        data.push_back( mValue + 2 );
-        data.push_back( mValue + 3 );
+    data.push_back( mValue + 0 );
+    data.push_back( mValue + 1 );
+    data.push_back( mValue + 2 );
+    data.push_back( mValue + 3 );
+
+    data.push_back( mValue + 4 );
+    data.push_back( mValue + 5 );
+    data.push_back( mValue + 6 );
+    data.push_back( mValue + 7 );
+
+    mValue++;
+
 
-        data.push_back( mValue + 4 );
-        data.push_back( mValue + 5 );
-        data.push_back( mValue + 6 );
-        data.push_back( mValue + 7 );
+    CreateDataOrRemoteFrame( 123, false, false, data, true );
+    WriteFrame();
 
-        mValue++;
+    CreateDataOrRemoteFrame( 321, true, false, data, true );
+    WriteFrame();
 
+    CreateDataOrRemoteFrame( 456, true, false, data, true );
+    WriteFrame( true );
 
-        CreateDataOrRemoteFrame( 123, false, false, data, true );
-        WriteFrame();
+    mWaveform.Advance( mClockGenerator.AdvanceByHalfPeriod( 40 ) );
 
-        CreateDataOrRemoteFrame( 321, true, false, data, true );
-        WriteFrame();
+    CreateDataOrRemoteFrame( 123, false, true, empty_data, true );
+    WriteFrame();
 
-        CreateDataOrRemoteFrame( 456, true, false, data, true );
-        WriteFrame( true );
+    CreateDataOrRemoteFrame( 321, true, true, empty_data, true );
+    WriteFrame();
 
-        mCanSimulationData.Advance( mClockGenerator.AdvanceByHalfPeriod( 40 ) );
+    mWaveform.Advance( mClockGenerator.AdvanceByHalfPeriod( 100 ) );
+}
+
+void CanSimulationDataGenerator::ReplayLog()
+{
+    CanLogFrame frame;
+    if( mLog.ReadFrame( frame ) == false )
+    {
+        // play the log again after a short idle, so the simulation can run as long as the capture.
+        mLog.Rewind();
+        mReplayPassStarted = false;
+        mWaveform.Advance( mClockGenerator.AdvanceByHalfPeriod( 100 ) );
 
-        CreateDataOrRemoteFrame( 123, false, true, empty_data, true );
-        WriteFrame();
+        if( mLog.ReadFrame( frame ) == false )
+        {
+            mWaveform.Advance( mSimulationSampleRateHz ); // nothing in the log we can send; idle for a second
+            return;
+        }
+    }
 
-        CreateDataOrRemoteFrame( 321, true, true, empty_data, true );
-        WriteFrame();
+    // keep the 3 bit intermission after the previous frame. a frame logged sooner than that, because the log was taken at a
+    // higher bit rate or its times are late, just follows it.
+    mWaveform.Advance( mClockGenerator.AdvanceByHalfPeriod( 3.0 ) );
 
-        mCanSimulationData.Advance( mClockGenerator.AdvanceByHalfPeriod( 100 ) );
+    if( mReplayPassStarted == false )
+    {
+        mReplayPassStarted = true;
+        mReplayStartSample = mWaveform.GetCurrentSampleNumber();
+        mReplayFirstTimeNs = frame.mTimeNs;
     }
 
-    *simulation_channels = &mCanSimulationData;
-    return 1; // we are retuning the size of the SimulationChannelDescriptor array.  In our case, the "array" is length 1.
+    U64 elapsed_ns = frame.mTimeNs > mReplayFirstTimeNs ? frame.mTimeNs - mReplayFirstTimeNs : 0;
+    U64 elapsed_samples = ( elapsed_ns / 1000000000ull ) * mSimulationSampleRateHz +
+                          ( elapsed_ns % 1000000000ull ) * mSimulationSampleRateHz / 1000000000ull;
+    mWaveform.AdvanceToSample( mReplayStartSample + elapsed_samples );
+
+    std::vector<U8> data( frame.mData, frame.mData + ( frame.mRemoteFrame ? 0 : frame.mDlc ) );
+    CreateDataOrRemoteFrame( frame.mIdentifier, frame.mExtended, frame.mRemoteFrame, data, true, frame.mDlc );
+    WriteFrame();
 }
 
 void CanSimulationDataGenerator::CreateDataOrRemoteFrame( U32 identifier, bool use_extended_frame_format, bool remote_frame,
-                                                          std::vector<U8>& data, bool get_ack_in_response )
+                                                          std::vector<U8>& data, bool get_ack_in_response, U32 remote_dlc )
 {
     // A DATA FRAME is composed of seven different bit fields:
     // START OF FRAME, ARBITRATION FIELD, CONTROL FIELD, DATA FIELD, CRC
@@ -192,8 +324,8 @@ void CanSimulationDataGenerator::CreateDataOrRemoteFrame( U32 identifier, bool u
         // LENGTH CODE and two reserved bits r1 and r0. The reserved bits have to be sent
         // dominant, but receivers accept dominant and recessive bits in all combinations.
 
-        mFakeControlField.push_back( mSettings->Recessive() ); // r1 bit
-        mFakeControlField.push_back( mSettings->Recessive() ); // r0 bit
+        mFakeControlField.push_back( mSettings->Dominant() ); // r1 bit
+        mFakeControlField.push_back( mSettings->Dominant() ); // r0 bit
     }
     else
     {
@@ -257,10 +389,13 @@ void CanSimulationDataGenerator::CreateDataOrRemoteFrame( U32 identifier, bool u
         if( data_size != 0 )
             AnalyzerHelpers::Assert( "remote frames can't send data" );
 
+    // a remote frame carries the DLC of the data frame it requests.
+    U32 dlc = remote_frame ? remote_dlc : data_size;
+
     U32 mask = 1 << 3;
     for( U32 i = 0; i < 4; i++ )
     {
-        if( ( mask & data_size ) == 0 )
+        if( ( mask & dlc ) == 0 )
             mFakeControlField.push_back( mSettings->Dominant() );
         else
             mFakeControlField.push_back( mSettings->Recessive() );
@@ -440,20 +575,20 @@ void CanSimulationDataGenerator::WriteFrame( bool error )
     {
         if( recessive_count == 5 )
         {
-            mCanSimulationData.Advance( mClockGenerator.AdvanceByHalfPeriod( 1.0 ) );
+            mWaveform.Advance( mClockGenerator.AdvanceByHalfPeriod( 1.0 ) );
             recessive_count = 0;
             dominant_count = 1; // this stuffed bit counts
 
-            mCanSimulationData.Transition(); // to DOMINANT
+            mWaveform.Transition(); // to DOMINANT
         }
 
         if( dominant_count == 5 )
         {
-            mCanSimulationData.Advance( mClockGenerator.AdvanceByHalfPeriod( 1.0 ) );
+            mWaveform.Advance( mClockGenerator.AdvanceByHalfPeriod( 1.0 ) );
             dominant_count = 0;
             recessive_count = 1; // this stuffed bit counts
 
-            mCanSimulationData.Transition(); // to RECESSIVE
+            mWaveform.Transition(); // to RECESSIVE
         }
 
         BitState bit = mFakeStuffedBits[ i ];
@@ -469,21 +604,28 @@ void CanSimulationDataGenerator::WriteFrame( bool error )
             recessive_count = 0;
         }
 
-        mCanSimulationData.Advance( mClockGenerator.AdvanceByHalfPeriod( 1.0 ) );
-        mCanSimulationData.TransitionIfNeeded( bit );
+        mWaveform.Advance( mClockGenerator.AdvanceByHalfPeriod( 1.0 ) );
+        mWaveform.TransitionIfNeeded( bit );
+    }
+
+    // the last bits of the CRC sequence are stuffed too.
+    if( error == false && ( recessive_count == 5 || dominant_count == 5 ) )
+    {
+        mWaveform.Advance( mClockGenerator.AdvanceByHalfPeriod( 1.0 ) );
+        mWaveform.Transition();
     }
 
     if( error == true )
     {
-        if( mCanSimulationData.GetCurrentBitState() != mSettings->Dominant() )
+        if( mWaveform.GetCurrentBitState() != mSettings->Dominant() )
         {
-            mCanSimulationData.Advance( mClockGenerator.AdvanceByHalfPeriod( 1.0 ) );
-            mCanSimulationData.Transition(); // to DOMINANT
+            mWaveform.Advance( mClockGenerator.AdvanceByHalfPeriod( 1.0 ) );
+            mWaveform.Transition(); // to DOMINANT
         }
 
-        mCanSimulationData.Advance( mClockGenerator.AdvanceByHalfPeriod( 8.0 ) );
+        mWaveform.Advance( mClockGenerator.AdvanceByHalfPeriod( 8.0 ) );
 
-        mCanSimulationData.Transition(); // to DOMINANT
+        mWaveform.Transition(); // to DOMINANT
 
         return;
     }
@@ -492,7 +634,7 @@ void CanSimulationDataGenerator::WriteFrame( bool error )
 
     for( U32 i = 0; i < count; i++ )
     {
-        mCanSimulationData.Advance( mClockGenerator.AdvanceByHalfPeriod( 1.0 ) );
-        mCanSimulationData.TransitionIfNeeded( mFakeFixedFormBits[ i ] );
+        mWaveform.Advance( mClockGenerator.AdvanceByHalfPeriod( 1.0 ) );
+        mWaveform.TransitionIfNeeded( mFakeFixedFormBits[ i ] );
     }
 }
@@ -1,7 +1,15 @@
 #ifndef CAN_SIMULATION_DATA_GENERATOR
 #define CAN_SIMULATION_DATA_GENERATOR
 
+#include "CanLogReader.h"
+#include "CanSimulationWaveform.h"
 #include <AnalyzerHelpers.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#define CAN_SIMULATION_SEGMENT_EDGES 4096 // a segment is handed over once it holds at least this many edges
+#define CAN_SIMULATION_QUEUE_SEGMENTS 16  // how far the generator thread may run ahead of the requests
 
 class CanAnalyzerSettings;
 
@@ -23,13 +31,31 @@ class CanSimulationDataGenerator
     U16 ComputeCrc( std::vector<BitState>& bits, U32 num_bits );
     void AddCrc();
     void CreateDataOrRemoteFrame( U32 identifier, bool use_extended_frame_format, bool remote_frame, std::vector<U8>& data,
-                                  bool get_ack_in_response );
+                                  bool get_ack_in_response, U32 remote_dlc = 0 );
     void WriteFrame( bool error = false );
+    void GeneratePattern();
+    void ReplayLog();
+
+    void StartGenerator();
+    void StopGenerator();
+    void GeneratorThread();
 
   protected: // vars
     ClockGenerator mClockGenerator;
     SimulationChannelDescriptor mCanSimulationData; // if we had more than one channel to simulate, they would need to be in an array
 
+    // frames are generated into mWaveform on mGeneratorThread, ahead of the requests. each finished segment goes into the ring of
+    // mQueue slots, and GenerateSimulationData swaps it out into mCurrentSegment and applies it to mCanSimulationData.
+    CanSimulationWaveform mWaveform;
+    std::thread mGeneratorThread;
+    std::mutex mQueueMutex;
+    std::condition_variable mQueueCondition;
+    CanSimulationSegment mQueue[ CAN_SIMULATION_QUEUE_SEGMENTS ];
+    U32 mQueueHead;
+    U32 mQueueSize;
+    bool mStopGenerator;
+    CanSimulationSegment mCurrentSegment;
+
     U8 mValue;
 
     std::vector<BitState> mFakeStartOfFrameField;
@@ -41,6 +67,13 @@ class CanSimulationDataGenerator
     std::vector<BitState> mFakeEndOfFrame;
     std::vector<BitState> mFakeStuffedBits;
     std::vector<BitState> mFakeFixedFormBits;
+
+    // log replay, when a log file is set. each pass through the log starts at mReplayStartSample, and each frame starts its
+    // logged time after the first frame of the pass.
+    CanLogReader mLog;
+    bool mReplayPassStarted;
+    U64 mReplayStartSample;
+    U64 mReplayFirstTimeNs;
 };
 
 #endif // CAN_SIMULATION_DATA_GENERATOR
@@ -0,0 +1,57 @@
+#include "CanSimulationWaveform.h"
+
+CanSimulationWaveform::CanSimulationWaveform() : mSampleNumber( 0 ), mBitState( BIT_HIGH )
+{
+}
+
+void CanSimulationWaveform::Reset( BitState initial_bit_state )
+{
+    mEdges.clear();
+    mSampleNumber = 0;
+    mBitState = initial_bit_state;
+}
+
+void CanSimulationWaveform::Advance( U32 num_samples )
+{
+    mSampleNumber += num_samples;
+}
+
+void CanSimulationWaveform::AdvanceToSample( U64 sample )
+{
+    if( sample > mSampleNumber )
+        mSampleNumber = sample;
+}
+
+void CanSimulationWaveform::Transition()
+{
+    mBitState = Invert( mBitState );
+    mEdges.push_back( mSampleNumber );
+}
+
+void CanSimulationWaveform::TransitionIfNeeded( BitState bit_state )
+{
+    if( bit_state != mBitState )
+        Transition();
+}
+
+U64 CanSimulationWaveform::GetCurrentSampleNumber() const
+{
+    return mSampleNumber;
+}
+
+BitState CanSimulationWaveform::GetCurrentBitState() const
+{
+    return mBitState;
+}
+
+U32 CanSimulationWaveform::GetNumEdges() const
+{
+    return U32( mEdges.size() );
+}
+
+void CanSimulationWaveform::TakeSegment( CanSimulationSegment& segment )
+{
+    segment.mEdges.swap( mEdges );
+    segment.mEndSample = mSampleNumber;
+    mEdges.clear();
+}
@@ -0,0 +1,39 @@
+#ifndef CAN_SIMULATION_WAVEFORM
+#define CAN_SIMULATION_WAVEFORM
+
+#include <AnalyzerTypes.h>
+#include <vector>
+
+// a stretch of simulated waveform: the samples where the level changes, up to mEndSample.
+struct CanSimulationSegment
+{
+    std::vector<U64> mEdges;
+    U64 mEndSample;
+};
+
+// Records a simulated channel as a list of edges, with the same calls as SimulationChannelDescriptor, so frames can be
+// generated away from the thread that owns the descriptor and handed over a segment at a time.
+class CanSimulationWaveform
+{
+  public:
+    CanSimulationWaveform();
+
+    void Reset( BitState initial_bit_state );
+
+    void Advance( U32 num_samples );
+    void AdvanceToSample( U64 sample );
+    void Transition();
+    void TransitionIfNeeded( BitState bit_state );
+    U64 GetCurrentSampleNumber() const;
+    BitState GetCurrentBitState() const;
+
+    U32 GetNumEdges() const; // since the last segment was taken
+    void TakeSegment( CanSimulationSegment& segment ); // the segment's old edge list is reused for the next one
+
+  protected:
+    std::vector<U64> mEdges;
+    U64 mSampleNumber;
+    BitState mBitState;
+};
+
+#endif // CAN_SIMULATION_WAVEFORM
@@ -0,0 +1,141 @@
+// can_bus_load_test: decodes a synthetic bus with a NACKed frame on it and checks that the bits charged to the frames, the
+// way the analyzer charges them to its bus load windows, never add up to more than the bus time they took.
+
+#include "CanEdgeBuffer.h"
+#include "CanFrameDecoder.h"
+#include <cstdio>
+#include <vector>
+
+#define SAMPLES_PER_BIT 10
+#define BIT_RATE 1000000
+
+namespace
+{
+    void AppendBits( std::vector<U32>& bits, U32 value, U32 num_bits )
+    {
+        for( U32 i = num_bits; i > 0; i-- )
+            bits.push_back( ( value >> ( i - 1 ) ) & 1 );
+    }
+
+    // a classical data frame with an 11-bit identifier, through its intermission. a NACKed frame can be followed by the
+    // transmitter's error flag and error delimiter, as on a real bus.
+    void AppendFrame( std::vector<U32>& bus, U32 identifier, U32 num_bytes, bool ack, bool error_flag )
+    {
+        std::vector<U32> bits;
+        bits.push_back( 0 );
+        AppendBits( bits, identifier, 11 );
+        AppendBits( bits, 0, 3 ); // RTR, IDE, r0
+        AppendBits( bits, num_bytes, 4 );
+        for( U32 i = 0; i < num_bytes; i++ )
+            AppendBits( bits, 0x11 * ( i + 1 ), 8 );
+
+        U32 crc = 0;
+        for( size_t i = 0; i < bits.size(); i++ )
+        {
+            U32 next_bit = bits[ i ] ^ ( crc >> 14 );
+            crc = ( crc << 1 ) & 0x7FFF;
+            if( next_bit != 0 )
+                crc ^= 0x4599;
+        }
+        AppendBits( bits, crc, 15 );
+
+        U32 run_bit = 2;
+        U32 run_length = 0;
+        for( size_t i = 0; i < bits.size(); i++ )
+        {
+            bus.push_back( bits[ i ] );
+            run_length = bits[ i ] == run_bit ? run_length + 1 : 1;
+            run_bit = bits[ i ];
+            if( run_length == 5 )
+            {
+                run_bit ^= 1;
+                run_length = 1;
+                bus.push_back( run_bit );
+            }
+        }
+
+        bus.push_back( 1 ); // CRC delimiter
+        bus.push_back( ack ? 0 : 1 );
+        bus.push_back( 1 ); // ACK delimiter
+
+        if( error_flag == true )
+        {
+            AppendBits( bus, 0, 6 );
+            AppendBits( bus, 0xFF, 8 );
+        }
+        else
+        {
+            AppendBits( bus, 0x7F, CAN_EOF_BITS );
+        }
+        AppendBits( bus, 0x7, CAN_INTERMISSION_BITS );
+    }
+
+    // decodes the bus and returns the bits charged to its frames; the bus starts idle, so every bit after the idle bits is
+    // bus time taken by a frame.
+    bool CheckBusLoad( const char* name, bool error_flag )
+    {
+        std::vector<U32> bus;
+        U32 idle_bits = 11;
+        AppendBits( bus, 0x7FF, idle_bits );
+        for( U32 i = 0; i < 6; i++ )
+            AppendFrame( bus, 0x100 + i, 8, i != 2, i == 2 && error_flag );
+        U64 bus_bits = bus.size() - idle_bits;
+        AppendBits( bus, 0x7FF, 11 );
+
+        std::vector<U64> edges;
+        for( size_t i = 1; i < bus.size(); i++ )
+        {
+            if( bus[ i ] != bus[ i - 1 ] )
+                edges.push_back( U64( i ) * SAMPLES_PER_BIT );
+        }
+        CanEdgeBuffer channel( &edges[ 0 ], edges.size(), BIT_HIGH, U64( bus.size() ) * SAMPLES_PER_BIT );
+
+        CanDecoderConfig config;
+        config.mSampleRateHz = BIT_RATE * SAMPLES_PER_BIT;
+        config.mBitRate = BIT_RATE;
+        config.mInverted = false;
+        config.mGlitchFilterNs = 0;
+        config.mXlDataBitRate = 0;
+        CanFrameDecoder decoder;
+        decoder.Init( &channel, config );
+
+        U64 charged_bits = 0;
+        U32 num_nacked = 0;
+        try
+        {
+            decoder.WaitFor7RecessiveBits();
+            for( ;; )
+            {
+                decoder.AdvanceToStartOfFrame();
+                decoder.DecodeFrame();
+                charged_bits += decoder.GetOccupiedBits();
+                if( decoder.IsFrameComplete() == true && decoder.IsError() == true && decoder.GetErrorType() == AckError )
+                    num_nacked++;
+
+                if( decoder.SawErrorFlag() == true )
+                    decoder.WaitFor7RecessiveBits();
+            }
+        }
+        catch( CanEndOfSamples& )
+        {
+        }
+
+        double load = 100.0 * double( charged_bits ) / double( bus_bits );
+        printf( "%s: %llu bits charged for %llu bits of bus time, %.1f%%\n", name, ( unsigned long long )charged_bits,
+                ( unsigned long long )bus_bits, load );
+
+        if( num_nacked != 1 )
+        {
+            printf( "%s: expected 1 complete frame with an ACK error, got %u\n", name, num_nacked );
+            return false;
+        }
+        return load <= 100.0;
+    }
+}
+
+int main()
+{
+    bool passed = CheckBusLoad( "nack", false );
+    passed = CheckBusLoad( "nack with error flag", true ) && passed;
+    return passed ? 0 : 1;
+}